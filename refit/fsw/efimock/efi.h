@@ -0,0 +1,329 @@
+/**
+ * \file efi.h
+ * Minimal stand-in for the EFI toolkit header, used to build the FSW EFI host
+ * as a POSIX program for testing (see efiasync.c). Only the parts that the
+ * host driver uses are declared. Disk I/O 2 is left out on purpose, as in the
+ * toolkit, so that fsw_efi.h supplies its own declarations.
+ */
+
+/*-
+ * Copyright (c) 2006 Christoph Pfisterer
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *  * Neither the name of Christoph Pfisterer nor the names of the
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EFIMOCK_EFI_H_
+#define _EFIMOCK_EFI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+//
+// Base types
+//
+
+typedef int8_t      INT8;
+typedef uint8_t     UINT8;
+typedef int16_t     INT16;
+typedef uint16_t    UINT16;
+typedef int32_t     INT32;
+typedef uint32_t    UINT32;
+typedef int64_t     INT64;
+typedef uint64_t    UINT64;
+typedef intptr_t    INTN;
+typedef uintptr_t   UINTN;
+typedef uint8_t     BOOLEAN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;     // L"" literals need -fshort-wchar
+#define VOID        void
+
+typedef UINTN       EFI_STATUS;
+typedef VOID        *EFI_HANDLE;
+typedef VOID        *EFI_EVENT;
+typedef UINTN       EFI_TPL;
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define EFIAPI
+
+#define TRUE        ((BOOLEAN)1)
+#define FALSE       ((BOOLEAN)0)
+
+typedef struct {
+    UINT32  Data1;
+    UINT16  Data2;
+    UINT16  Data3;
+    UINT8   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+    UINT16  Year;
+    UINT8   Month;
+    UINT8   Day;
+    UINT8   Hour;
+    UINT8   Minute;
+    UINT8   Second;
+    UINT8   Pad1;
+    UINT32  Nanosecond;
+    INT16   TimeZone;
+    UINT8   Daylight;
+    UINT8   Pad2;
+} EFI_TIME;
+
+
+//
+// Status codes
+//
+
+#define EFI_ERROR_BIT               ((UINTN)1 << (sizeof(UINTN) * 8 - 1))
+#define EFIERR(a)                   (EFI_ERROR_BIT | (a))
+#define EFI_ERROR(a)                (((INTN)(a)) < 0)
+
+#define EFI_SUCCESS                 0
+#define EFI_INVALID_PARAMETER       EFIERR(2)
+#define EFI_UNSUPPORTED             EFIERR(3)
+#define EFI_BUFFER_TOO_SMALL        EFIERR(5)
+#define EFI_NOT_READY               EFIERR(6)
+#define EFI_DEVICE_ERROR            EFIERR(7)
+#define EFI_WRITE_PROTECTED         EFIERR(8)
+#define EFI_VOLUME_CORRUPTED        EFIERR(10)
+#define EFI_NOT_FOUND               EFIERR(14)
+#define EFI_MEDIA_CHANGED           EFIERR(13)
+#define EFI_WARN_DELETE_FAILURE     2
+
+
+//
+// Helper macros
+//
+
+#define EFI_SIGNATURE_16(a,b)       ((a) | ((b) << 8))
+#define EFI_SIGNATURE_32(a,b,c,d)   (EFI_SIGNATURE_16(a,b) | (EFI_SIGNATURE_16(c,d) << 16))
+#define CR(Record, TYPE, Field, Signature) \
+    ((TYPE *)((CHAR8 *)(Record) - offsetof(TYPE, Field)))
+
+#define EFI_DRIVER_ENTRY_POINT(f)
+
+// fsw_efi.c widens stringified names with L#x, which only the Microsoft compiler
+// accepts; with L expanding to nothing, GCC concatenates the wide and narrow literals
+#define L
+
+
+//
+// File protocol
+//
+
+#define EFI_FILE_HANDLE_REVISION        0x00010000
+#define EFI_FILE_IO_INTERFACE_REVISION  0x00010000
+
+#define EFI_FILE_MODE_READ      0x0000000000000001ULL
+#define EFI_FILE_MODE_WRITE     0x0000000000000002ULL
+#define EFI_FILE_MODE_CREATE    0x8000000000000000ULL
+
+#define EFI_FILE_READ_ONLY      0x0000000000000001ULL
+#define EFI_FILE_HIDDEN         0x0000000000000002ULL
+#define EFI_FILE_SYSTEM         0x0000000000000004ULL
+#define EFI_FILE_DIRECTORY      0x0000000000000010ULL
+
+struct _EFI_FILE;
+
+typedef struct _EFI_FILE {
+    UINT64      Revision;
+    EFI_STATUS  (EFIAPI *Open)(struct _EFI_FILE *File, struct _EFI_FILE **NewHandle,
+                               CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes);
+    EFI_STATUS  (EFIAPI *Close)(struct _EFI_FILE *File);
+    EFI_STATUS  (EFIAPI *Delete)(struct _EFI_FILE *File);
+    EFI_STATUS  (EFIAPI *Read)(struct _EFI_FILE *File, UINTN *BufferSize, VOID *Buffer);
+    EFI_STATUS  (EFIAPI *Write)(struct _EFI_FILE *File, UINTN *BufferSize, VOID *Buffer);
+    EFI_STATUS  (EFIAPI *GetPosition)(struct _EFI_FILE *File, UINT64 *Position);
+    EFI_STATUS  (EFIAPI *SetPosition)(struct _EFI_FILE *File, UINT64 Position);
+    EFI_STATUS  (EFIAPI *GetInfo)(struct _EFI_FILE *File, EFI_GUID *InformationType,
+                                  UINTN *BufferSize, VOID *Buffer);
+    EFI_STATUS  (EFIAPI *SetInfo)(struct _EFI_FILE *File, EFI_GUID *InformationType,
+                                  UINTN BufferSize, VOID *Buffer);
+    EFI_STATUS  (EFIAPI *Flush)(struct _EFI_FILE *File);
+} EFI_FILE, *EFI_FILE_HANDLE;
+
+typedef struct {
+    UINT64      Size;
+    UINT64      FileSize;
+    UINT64      PhysicalSize;
+    EFI_TIME    CreateTime;
+    EFI_TIME    LastAccessTime;
+    EFI_TIME    ModificationTime;
+    UINT64      Attribute;
+    CHAR16      FileName[1];
+} EFI_FILE_INFO;
+
+#define SIZE_OF_EFI_FILE_INFO   offsetof(EFI_FILE_INFO, FileName)
+
+typedef struct {
+    UINT64      Size;
+    BOOLEAN     ReadOnly;
+    UINT64      VolumeSize;
+    UINT64      FreeSpace;
+    UINT32      BlockSize;
+    CHAR16      VolumeLabel[1];
+} EFI_FILE_SYSTEM_INFO;
+
+#define SIZE_OF_EFI_FILE_SYSTEM_INFO    offsetof(EFI_FILE_SYSTEM_INFO, VolumeLabel)
+
+typedef struct {
+    CHAR16      VolumeLabel[1];
+} EFI_FILE_SYSTEM_VOLUME_LABEL_INFO;
+
+#define SIZE_OF_EFI_FILE_SYSTEM_VOLUME_LABEL_INFO   offsetof(EFI_FILE_SYSTEM_VOLUME_LABEL_INFO, VolumeLabel)
+
+typedef struct _EFI_FILE_IO_INTERFACE {
+    UINT64      Revision;
+    EFI_STATUS  (EFIAPI *OpenVolume)(struct _EFI_FILE_IO_INTERFACE *This, EFI_FILE **Root);
+} EFI_FILE_IO_INTERFACE;
+
+
+//
+// Disk I/O and Block I/O protocols
+//
+
+typedef struct _EFI_DISK_IO {
+    UINT64      Revision;
+    EFI_STATUS  (EFIAPI *ReadDisk)(struct _EFI_DISK_IO *This, UINT32 MediaId,
+                                   UINT64 Offset, UINTN BufferSize, VOID *Buffer);
+    EFI_STATUS  (EFIAPI *WriteDisk)(struct _EFI_DISK_IO *This, UINT32 MediaId,
+                                    UINT64 Offset, UINTN BufferSize, VOID *Buffer);
+} EFI_DISK_IO;
+
+typedef struct {
+    UINT32      MediaId;
+    BOOLEAN     RemovableMedia;
+    BOOLEAN     MediaPresent;
+    BOOLEAN     LogicalPartition;
+    BOOLEAN     ReadOnly;
+    BOOLEAN     WriteCaching;
+    UINT32      BlockSize;
+    UINT32      IoAlign;
+    UINT64      LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+typedef struct _EFI_BLOCK_IO {
+    UINT64      Revision;
+    EFI_BLOCK_IO_MEDIA *Media;
+} EFI_BLOCK_IO;
+
+
+//
+// Driver model protocols
+//
+
+typedef struct {
+    UINT8       Type;
+    UINT8       SubType;
+    UINT8       Length[2];
+} EFI_DEVICE_PATH_PROTOCOL;
+
+struct _EFI_DRIVER_BINDING_PROTOCOL;
+
+typedef struct _EFI_DRIVER_BINDING_PROTOCOL {
+    EFI_STATUS  (EFIAPI *Supported)(struct _EFI_DRIVER_BINDING_PROTOCOL *This,
+                                    EFI_HANDLE ControllerHandle, EFI_DEVICE_PATH_PROTOCOL *RemainingDevicePath);
+    EFI_STATUS  (EFIAPI *Start)(struct _EFI_DRIVER_BINDING_PROTOCOL *This,
+                                EFI_HANDLE ControllerHandle, EFI_DEVICE_PATH_PROTOCOL *RemainingDevicePath);
+    EFI_STATUS  (EFIAPI *Stop)(struct _EFI_DRIVER_BINDING_PROTOCOL *This,
+                               EFI_HANDLE ControllerHandle, UINTN NumberOfChildren, EFI_HANDLE *ChildHandleBuffer);
+    UINT32      Version;
+    EFI_HANDLE  ImageHandle;
+    EFI_HANDLE  DriverBindingHandle;
+} EFI_DRIVER_BINDING_PROTOCOL;
+
+typedef struct _EFI_COMPONENT_NAME_PROTOCOL {
+    EFI_STATUS  (EFIAPI *GetDriverName)(struct _EFI_COMPONENT_NAME_PROTOCOL *This,
+                                        CHAR8 *Language, CHAR16 **DriverName);
+    EFI_STATUS  (EFIAPI *GetControllerName)(struct _EFI_COMPONENT_NAME_PROTOCOL *This,
+                                            EFI_HANDLE ControllerHandle, EFI_HANDLE ChildHandle,
+                                            CHAR8 *Language, CHAR16 **ControllerName);
+    CHAR8       *SupportedLanguages;
+} EFI_COMPONENT_NAME_PROTOCOL;
+
+
+//
+// Boot services
+//
+
+#define EFI_OPEN_PROTOCOL_BY_HANDLE_PROTOCOL    0x00000001
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL          0x00000002
+#define EFI_OPEN_PROTOCOL_TEST_PROTOCOL         0x00000004
+#define EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER   0x00000008
+#define EFI_OPEN_PROTOCOL_BY_DRIVER             0x00000010
+#define EFI_OPEN_PROTOCOL_EXCLUSIVE             0x00000020
+
+typedef enum {
+    EFI_NATIVE_INTERFACE
+} EFI_INTERFACE_TYPE;
+
+typedef VOID (EFIAPI *EFI_EVENT_NOTIFY)(EFI_EVENT Event, VOID *Context);
+
+typedef struct {
+    EFI_STATUS  (EFIAPI *CreateEvent)(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                      VOID *NotifyContext, EFI_EVENT *Event);
+    EFI_STATUS  (EFIAPI *CloseEvent)(EFI_EVENT Event);
+    EFI_STATUS  (EFIAPI *CheckEvent)(EFI_EVENT Event);
+    EFI_STATUS  (EFIAPI *InstallProtocolInterface)(EFI_HANDLE *Handle, EFI_GUID *Protocol,
+                                                   EFI_INTERFACE_TYPE InterfaceType, VOID *Interface);
+    EFI_STATUS  (EFIAPI *OpenProtocol)(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface,
+                                       EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle, UINT32 Attributes);
+    EFI_STATUS  (EFIAPI *CloseProtocol)(EFI_HANDLE Handle, EFI_GUID *Protocol,
+                                        EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle);
+    EFI_STATUS  (EFIAPI *InstallMultipleProtocolInterfaces)(EFI_HANDLE *Handle, ...);
+    EFI_STATUS  (EFIAPI *UninstallMultipleProtocolInterfaces)(EFI_HANDLE Handle, ...);
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+    EFI_BOOT_SERVICES   *BootServices;
+} EFI_SYSTEM_TABLE;
+
+
+//
+// Globals provided by the library
+//
+
+extern EFI_BOOT_SERVICES *BS;
+
+extern EFI_GUID DiskIoProtocol;
+extern EFI_GUID BlockIoProtocol;
+extern EFI_GUID FileSystemProtocol;
+extern EFI_GUID DriverBindingProtocol;
+extern EFI_GUID ComponentNameProtocol;
+extern EFI_GUID GenericFileInfo;
+extern EFI_GUID FileSystemInfo;
+extern EFI_GUID FileSystemVolumeLabelInfo;
+
+
+#endif
+
+// EOF
@@ -0,0 +1,801 @@
+/**
+ * \file efiasync.c
+ * Test program for the Disk I/O 2 read-ahead path of the EFI host.
+ *
+ * The EFI host is built as a POSIX program against the stand-in headers in
+ * this directory. Boot services, Disk I/O and Disk I/O 2 are replaced by mock
+ * implementations backed by a disk image file. Queued reads complete one at a
+ * time whenever the driver checks an event, either in submission order or in
+ * reverse order, and reads can be made to fail at submission or on completion.
+ * All data returned by fsw_efi_read_blocks is compared against the image.
+ *
+ * Build and run from the fsw directory:
+ *
+ *   cc -fshort-wchar -DHOST_EFI -DFSTYPE=ext2 -Iefimock -I. -o efiasync \
+ *      efimock/efiasync.c fsw_efi.c fsw_efi_lib.c fsw_core.c fsw_lib.c fsw_ext2.c
+ *   ./efiasync <image> [<path> <reference file>]
+ *
+ * If a path (with backslashes) and a reference file are given, the file is
+ * also read through the Simple File System protocol and compared.
+ */
+
+/*-
+ * Copyright (c) 2006 Christoph Pfisterer
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *  * Neither the name of Christoph Pfisterer nor the names of the
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fsw_efi.h"
+
+
+// entry points of the EFI host under test
+
+extern EFI_DRIVER_BINDING_PROTOCOL fsw_efi_DriverBinding_table;
+
+EFI_STATUS EFIAPI fsw_efi_main(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable);
+fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_status_t fsw_efi_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+
+
+#define MOCK_MAX_EVENTS (64)
+#define MOCK_MAX_OPS    (64)
+#define MOCK_MEDIA_ID   (7)
+
+#define COMPLETE_FIFO   (0)
+#define COMPLETE_LIFO   (1)
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { if (!(cond)) { failures++; \
+    printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); } } while (0)
+
+
+//
+// Mock device state
+//
+
+static int              image_fd = -1;
+static UINT64           image_size;
+
+/** A queued Disk I/O 2 read. */
+struct mock_op {
+    EFI_DISK_IO2_TOKEN  *Token;
+    UINT64              Offset;
+    UINTN               Size;
+    UINT8               *Buffer;
+    BOOLEAN             Fail;
+};
+
+/** An event created through the mock boot services. */
+struct mock_event {
+    BOOLEAN             Open;
+    BOOLEAN             Signaled;
+};
+
+static struct mock_op       ops[MOCK_MAX_OPS];
+static UINTN                op_count;
+static struct mock_event    events[MOCK_MAX_EVENTS];
+
+/** Fault injection and behaviour switches for one test pass. */
+static struct {
+    int                 complete_order;     // COMPLETE_FIFO or COMPLETE_LIFO
+    int                 have_diskio2;       // publish Disk I/O 2 on the controller
+    int                 submit_fail_every;  // every nth ReadDiskEx fails right away, 0 = never
+    int                 txn_fail_every;     // every nth queued read completes with an error, 0 = never
+    int                 event_fail_at;      // the nth CreateEvent fails, 0 = never
+} mode;
+
+/** Counters for one test pass. */
+static struct {
+    unsigned long       read_disk;
+    unsigned long long  read_disk_bytes;
+    unsigned long       read_disk_ex;
+    unsigned long       read_disk_ex_submitted;
+    unsigned long       read_disk_ex_failed_txn;
+    unsigned long       events_created;
+} counters;
+
+static EFI_DISK_IO              mock_DiskIo;
+static EFI_DISK_IO2_PROTOCOL    mock_DiskIo2;
+static EFI_BLOCK_IO_MEDIA       mock_Media;
+static EFI_BLOCK_IO             mock_BlockIo;
+static EFI_FILE_IO_INTERFACE    *installed_FileSystem;
+static int                      controller;     // its address is the controller handle
+
+
+//
+// Pool allocation with a header, so that misuse of memory owned by the device shows up
+//
+
+#define POOL_MAGIC (0x506f6f6cUL)
+
+struct pool_header {
+    UINT64              Magic;
+    UINT64              Size;
+};
+
+static UINTN pool_size(VOID *Buffer)
+{
+    struct pool_header *h = (struct pool_header *)Buffer - 1;
+    
+    if (h->Magic != POOL_MAGIC) {
+        printf("FATAL: pointer %p was not allocated from the pool\n", Buffer);
+        exit(2);
+    }
+    return (UINTN)h->Size;
+}
+
+VOID *AllocatePool(UINTN Size)
+{
+    struct pool_header *h = malloc(sizeof(struct pool_header) + Size);
+    
+    if (h == NULL)
+        return NULL;
+    h->Magic = POOL_MAGIC;
+    h->Size = Size;
+    memset(h + 1, 0xEE, Size);
+    return h + 1;
+}
+
+VOID *AllocateZeroPool(UINTN Size)
+{
+    VOID *Buffer = AllocatePool(Size);
+    
+    if (Buffer != NULL)
+        memset(Buffer, 0, Size);
+    return Buffer;
+}
+
+VOID FreePool(VOID *Buffer)
+{
+    struct pool_header *h = (struct pool_header *)Buffer - 1;
+    UINT8   *start = Buffer;
+    UINT8   *end = start + pool_size(Buffer);
+    UINTN   i;
+    
+    // the device still owns buffers and tokens of queued reads
+    for (i = 0; i < op_count; i++) {
+        if ((ops[i].Buffer < end && ops[i].Buffer + ops[i].Size > start) ||
+            ((UINT8 *)ops[i].Token >= start && (UINT8 *)ops[i].Token < end)) {
+            printf("FATAL: FreePool(%p) while a queued read still uses it\n", Buffer);
+            exit(2);
+        }
+    }
+    memset(Buffer, 0xDD, end - start);
+    h->Magic = 0;
+    free(h);
+}
+
+
+//
+// Library functions
+//
+
+EFI_BOOT_SERVICES *BS;
+
+VOID InitializeLib(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
+{
+    BS = SystemTable->BootServices;
+}
+
+VOID ZeroMem(VOID *Buffer, UINTN Size)
+{
+    memset(Buffer, 0, Size);
+}
+
+VOID CopyMem(VOID *Dest, VOID *Src, UINTN Size)
+{
+    memmove(Dest, Src, Size);
+}
+
+INTN CompareMem(VOID *Dest, VOID *Src, UINTN Size)
+{
+    return memcmp(Dest, Src, Size);
+}
+
+INTN CompareGuid(EFI_GUID *Guid1, EFI_GUID *Guid2)
+{
+    return memcmp(Guid1, Guid2, sizeof(EFI_GUID)) != 0;
+}
+
+UINTN StrLen(CHAR16 *s)
+{
+    UINTN len = 0;
+    
+    while (s[len])
+        len++;
+    return len;
+}
+
+UINTN Print(CHAR16 *fmt, ...)
+{
+    char    buf[512];
+    UINTN   i, j;
+    va_list ap;
+    
+    // narrow the format; EFI_STATUS values are printed with %x
+    for (i = 0, j = 0; fmt[i] && j < sizeof(buf) - 2; i++) {
+        if (fmt[i] == '%' && fmt[i+1] == 'x')
+            buf[j++] = '%', buf[j++] = 'l';
+        else
+            buf[j++] = (char)fmt[i];
+    }
+    buf[j] = 0;
+    va_start(ap, fmt);
+    vprintf(buf, ap);
+    va_end(ap);
+    return j;
+}
+
+UINT64 RShiftU64(UINT64 Operand, UINTN Count)
+{
+    return Operand >> Count;
+}
+
+UINT64 DivU64x32(UINT64 Dividend, UINTN Divisor, UINTN *Remainder)
+{
+    if (Remainder != NULL)
+        *Remainder = (UINTN)(Dividend % Divisor);
+    return Dividend / Divisor;
+}
+
+EFI_GUID DiskIoProtocol             = { 0xce345171, 0xba0b, 0x11d2, { 0x8e, 0x4f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID BlockIoProtocol            = { 0x964e5b21, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID FileSystemProtocol         = { 0x964e5b22, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID DriverBindingProtocol      = { 0x18a031ab, 0xb443, 0x4d1a, { 0xa5, 0xc0, 0x0c, 0x09, 0x26, 0x1e, 0x9f, 0x71 } };
+EFI_GUID ComponentNameProtocol      = { 0x107a772c, 0xd5e1, 0x11d4, { 0x9a, 0x46, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+EFI_GUID GenericFileInfo            = { 0x09576e92, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID FileSystemInfo             = { 0x09576e93, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } };
+EFI_GUID FileSystemVolumeLabelInfo  = { 0xdb47d7d3, 0xfe81, 0x11d3, { 0x9a, 0x35, 0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d } };
+
+static EFI_GUID mock_DiskIo2Protocol = EFI_DISK_IO2_PROTOCOL_GUID;
+
+
+//
+// Events
+//
+
+static struct mock_event *mock_event_get(EFI_EVENT Event, const char *caller)
+{
+    struct mock_event *ev = (struct mock_event *)Event;
+    
+    if (ev < events || ev >= events + MOCK_MAX_EVENTS || !ev->Open) {
+        printf("FATAL: %s on an invalid event %p\n", caller, Event);
+        exit(2);
+    }
+    return ev;
+}
+
+static EFI_STATUS EFIAPI mock_CreateEvent(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                          VOID *NotifyContext, EFI_EVENT *Event)
+{
+    UINTN i;
+    
+    counters.events_created++;
+    if (mode.event_fail_at != 0 && counters.events_created == (unsigned long)mode.event_fail_at)
+        return EFI_INVALID_PARAMETER;
+    for (i = 0; i < MOCK_MAX_EVENTS; i++) {
+        if (!events[i].Open) {
+            events[i].Open = TRUE;
+            events[i].Signaled = FALSE;
+            *Event = &events[i];
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_INVALID_PARAMETER;
+}
+
+static EFI_STATUS EFIAPI mock_CloseEvent(EFI_EVENT Event)
+{
+    struct mock_event *ev = mock_event_get(Event, "CloseEvent");
+    UINTN i;
+    
+    for (i = 0; i < op_count; i++) {
+        if (ops[i].Token->Event == Event) {
+            printf("FATAL: CloseEvent while a queued read signals it\n");
+            exit(2);
+        }
+    }
+    ev->Open = FALSE;
+    ev->Signaled = FALSE;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Let the device finish one queued read. Reads are completed oldest first or newest
+ * first depending on the mode, so requests can complete out of order.
+ */
+
+static VOID mock_device_step(VOID)
+{
+    struct mock_op op;
+    UINTN   index;
+    
+    if (op_count == 0)
+        return;
+    index = (mode.complete_order == COMPLETE_FIFO) ? 0 : op_count - 1;
+    op = ops[index];
+    memmove(&ops[index], &ops[index + 1], (op_count - index - 1) * sizeof(struct mock_op));
+    op_count--;
+    
+    if (op.Fail) {
+        memset(op.Buffer, 0xA5, op.Size);
+        op.Token->TransactionStatus = EFI_DEVICE_ERROR;
+    } else if (pread(image_fd, op.Buffer, op.Size, (off_t)op.Offset) != (ssize_t)op.Size) {
+        printf("FATAL: pread failed\n");
+        exit(2);
+    } else {
+        op.Token->TransactionStatus = EFI_SUCCESS;
+    }
+    mock_event_get(op.Token->Event, "completion")->Signaled = TRUE;
+}
+
+static EFI_STATUS EFIAPI mock_CheckEvent(EFI_EVENT Event)
+{
+    struct mock_event *ev = mock_event_get(Event, "CheckEvent");
+    UINTN i;
+    
+    if (!ev->Signaled) {
+        // polling an event nobody will signal would hang the driver
+        for (i = 0; i < op_count; i++)
+            if (ops[i].Token->Event == Event)
+                break;
+        if (i == op_count) {
+            printf("FATAL: CheckEvent on an event without a queued read\n");
+            exit(2);
+        }
+        mock_device_step();
+    }
+    if (!ev->Signaled)
+        return EFI_NOT_READY;
+    ev->Signaled = FALSE;
+    return EFI_SUCCESS;
+}
+
+
+//
+// Protocols on the controller
+//
+
+static EFI_STATUS EFIAPI mock_ReadDisk(EFI_DISK_IO *This, UINT32 MediaId,
+                                       UINT64 Offset, UINTN BufferSize, VOID *Buffer)
+{
+    CHECK(This == &mock_DiskIo && MediaId == MOCK_MEDIA_ID, "ReadDisk with wrong instance or media");
+    if (Offset + BufferSize > image_size)
+        return EFI_INVALID_PARAMETER;
+    counters.read_disk++;
+    counters.read_disk_bytes += BufferSize;
+    if (pread(image_fd, Buffer, BufferSize, (off_t)Offset) != (ssize_t)BufferSize)
+        return EFI_DEVICE_ERROR;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_ReadDiskEx(EFI_DISK_IO2_PROTOCOL *This, UINT32 MediaId,
+                                         UINT64 Offset, EFI_DISK_IO2_TOKEN *Token,
+                                         UINTN BufferSize, VOID *Buffer)
+{
+    struct mock_event *ev;
+    UINTN i;
+    
+    CHECK(This == &mock_DiskIo2 && MediaId == MOCK_MEDIA_ID, "ReadDiskEx with wrong instance or media");
+    CHECK(Token != NULL && Token->Event != NULL, "ReadDiskEx without an event");
+    counters.read_disk_ex++;
+    if (Offset + BufferSize > image_size)
+        return EFI_INVALID_PARAMETER;
+    if (mode.submit_fail_every != 0 && counters.read_disk_ex % mode.submit_fail_every == 0)
+        return EFI_DEVICE_ERROR;
+    
+    ev = mock_event_get(Token->Event, "ReadDiskEx");
+    CHECK(!ev->Signaled, "ReadDiskEx reuses an event with an unconsumed signal");
+    CHECK(pool_size(Buffer) >= BufferSize, "ReadDiskEx buffer is smaller than the request");
+    for (i = 0; i < op_count; i++) {
+        CHECK(ops[i].Token != Token && ops[i].Token->Event != Token->Event,
+              "ReadDiskEx reuses a token that is still queued");
+        CHECK(ops[i].Buffer + ops[i].Size <= (UINT8 *)Buffer || (UINT8 *)Buffer + BufferSize <= ops[i].Buffer,
+              "ReadDiskEx buffer overlaps a queued read");
+    }
+    if (op_count == MOCK_MAX_OPS)
+        return EFI_DEVICE_ERROR;
+    
+    // the contents of the buffer are undefined until the read completes
+    memset(Buffer, 0x5A, BufferSize);
+    
+    counters.read_disk_ex_submitted++;
+    ops[op_count].Token  = Token;
+    ops[op_count].Offset = Offset;
+    ops[op_count].Size   = BufferSize;
+    ops[op_count].Buffer = Buffer;
+    ops[op_count].Fail   = (mode.txn_fail_every != 0 &&
+                            counters.read_disk_ex_submitted % mode.txn_fail_every == 0);
+    if (ops[op_count].Fail)
+        counters.read_disk_ex_failed_txn++;
+    op_count++;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_OpenProtocol(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface,
+                                           EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle, UINT32 Attributes)
+{
+    VOID *Found;
+    
+    if (Handle != &controller)
+        return EFI_UNSUPPORTED;
+    if (CompareGuid(Protocol, &DiskIoProtocol) == 0)
+        Found = &mock_DiskIo;
+    else if (CompareGuid(Protocol, &BlockIoProtocol) == 0)
+        Found = &mock_BlockIo;
+    else if (CompareGuid(Protocol, &mock_DiskIo2Protocol) == 0 && mode.have_diskio2)
+        Found = &mock_DiskIo2;
+    else if (CompareGuid(Protocol, &FileSystemProtocol) == 0 && installed_FileSystem != NULL)
+        Found = installed_FileSystem;
+    else
+        return EFI_UNSUPPORTED;
+    if (Interface != NULL)
+        *Interface = Found;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_CloseProtocol(EFI_HANDLE Handle, EFI_GUID *Protocol,
+                                            EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_InstallProtocolInterface(EFI_HANDLE *Handle, EFI_GUID *Protocol,
+                                                       EFI_INTERFACE_TYPE InterfaceType, VOID *Interface)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_InstallMultipleProtocolInterfaces(EFI_HANDLE *Handle, ...)
+{
+    va_list     ap;
+    EFI_GUID    *Protocol;
+    
+    va_start(ap, Handle);
+    while ((Protocol = va_arg(ap, EFI_GUID *)) != NULL) {
+        VOID *Interface = va_arg(ap, VOID *);
+        if (CompareGuid(Protocol, &FileSystemProtocol) == 0)
+            installed_FileSystem = Interface;
+    }
+    va_end(ap);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI mock_UninstallMultipleProtocolInterfaces(EFI_HANDLE Handle, ...)
+{
+    va_list     ap;
+    EFI_GUID    *Protocol;
+    
+    va_start(ap, Handle);
+    while ((Protocol = va_arg(ap, EFI_GUID *)) != NULL) {
+        VOID *Interface = va_arg(ap, VOID *);
+        if (CompareGuid(Protocol, &FileSystemProtocol) == 0 && Interface == installed_FileSystem)
+            installed_FileSystem = NULL;
+    }
+    va_end(ap);
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES mock_BootServices = {
+    mock_CreateEvent,
+    mock_CloseEvent,
+    mock_CheckEvent,
+    mock_InstallProtocolInterface,
+    mock_OpenProtocol,
+    mock_CloseProtocol,
+    mock_InstallMultipleProtocolInterfaces,
+    mock_UninstallMultipleProtocolInterfaces,
+};
+
+static EFI_SYSTEM_TABLE mock_SystemTable = {
+    &mock_BootServices,
+};
+
+
+//
+// Test passes
+//
+
+static unsigned long rand_state;
+
+static unsigned long next_rand(void)
+{
+    rand_state = rand_state * 1103515245UL + 12345UL;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+/**
+ * Read a run of blocks through the host and compare it against the image.
+ */
+
+static void check_read(FSW_VOLUME_DATA *Volume, fsw_u64 bno, fsw_u32 count)
+{
+    struct fsw_volume *vol = Volume->vol;
+    UINTN   size = (UINTN)count * vol->phys_blocksize;
+    UINT8   *got = malloc(size);
+    UINT8   *want = malloc(size);
+    fsw_status_t status;
+    
+    memset(got, 0xCC, size);
+    if (count == 1 && (next_rand() & 1))
+        status = fsw_efi_read_block(vol, bno, got);
+    else
+        status = fsw_efi_read_blocks(vol, bno, count, got);
+    if (status != FSW_SUCCESS) {
+        printf("FAIL: read %llu+%u returned %d\n", (unsigned long long)bno, count, status);
+        failures++;
+    } else {
+        pread(image_fd, want, size, (off_t)(bno * vol->phys_blocksize));
+        if (memcmp(got, want, size) != 0) {
+            printf("FAIL: read %llu+%u returned wrong data\n", (unsigned long long)bno, count);
+            failures++;
+        }
+    }
+    free(got);
+    free(want);
+}
+
+/**
+ * Read a file through the Simple File System protocol and compare it to a reference file.
+ */
+
+static void check_file(FSW_VOLUME_DATA *Volume, const char *path, const char *ref_path)
+{
+    EFI_FILE    *Root, *File;
+    CHAR16      name[1024];
+    UINTN       i, size, chunk;
+    UINT8       *got, *want;
+    struct stat st;
+    int         fd;
+    EFI_STATUS  Status;
+    
+    for (i = 0; path[i] && i < 1023; i++)
+        name[i] = (path[i] == '/') ? '\\' : (CHAR16)path[i];
+    name[i] = 0;
+    
+    fd = open(ref_path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("FATAL: cannot open reference file %s\n", ref_path);
+        exit(2);
+    }
+    want = malloc(st.st_size + 1);
+    got = malloc(st.st_size + 1);
+    pread(fd, want, st.st_size, 0);
+    close(fd);
+    
+    Status = Volume->FileSystem.OpenVolume(&Volume->FileSystem, &Root);
+    CHECK(!EFI_ERROR(Status), "OpenVolume failed");
+    if (EFI_ERROR(Status))
+        return;
+    Status = Root->Open(Root, &File, name, EFI_FILE_MODE_READ, 0);
+    CHECK(!EFI_ERROR(Status), "Open failed");
+    if (!EFI_ERROR(Status)) {
+        // odd chunk sizes, so block runs start and end in the middle of blocks
+        for (i = 0, chunk = 7001; ; i += size, chunk = chunk * 3 % 200003 + 1) {
+            size = chunk;
+            if (i + size > (UINTN)st.st_size + 1)
+                size = st.st_size + 1 - i;
+            Status = File->Read(File, &size, got + i);
+            CHECK(!EFI_ERROR(Status), "Read failed");
+            if (EFI_ERROR(Status) || size == 0)
+                break;
+        }
+        CHECK(i == (UINTN)st.st_size, "file size differs from the reference");
+        CHECK(memcmp(got, want, st.st_size) == 0, "file data differs from the reference");
+        File->Close(File);
+    }
+    Root->Close(Root);
+    free(got);
+    free(want);
+}
+
+static int events_open(void)
+{
+    int i, n = 0;
+    
+    for (i = 0; i < MOCK_MAX_EVENTS; i++)
+        if (events[i].Open)
+            n++;
+    return n;
+}
+
+/**
+ * Mount the image, run the read patterns, and unmount with read-ahead still in flight.
+ */
+
+static void run_pass(const char *name, const char *path, const char *ref_path)
+{
+    EFI_STATUS          Status;
+    EFI_FILE_IO_INTERFACE *FileSystem;
+    FSW_VOLUME_DATA     *Volume;
+    struct fsw_volume   *vol;
+    fsw_u64             nblocks, bno;
+    fsw_u32             count, cap;
+    unsigned long       sync_reads;
+    unsigned long long  sync_bytes;
+    int                 i, failures_before = failures;
+    
+    memset(&counters, 0, sizeof(counters));
+    rand_state = 1;
+    
+    Status = fsw_efi_DriverBinding_table.Start(&fsw_efi_DriverBinding_table, &controller, NULL);
+    CHECK(!EFI_ERROR(Status), "Start failed");
+    if (EFI_ERROR(Status))
+        return;
+    mock_BootServices.OpenProtocol(&controller, &FileSystemProtocol, (VOID **) &FileSystem,
+                                   fsw_efi_DriverBinding_table.DriverBindingHandle, &controller,
+                                   EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+    Volume = FSW_VOLUME_FROM_FILE_SYSTEM(FileSystem);
+    vol = Volume->vol;
+    nblocks = image_size / vol->phys_blocksize;
+    cap = FSW_EFI_ASYNC_MAX_SIZE / vol->phys_blocksize;
+    
+    if (!mode.have_diskio2 || mode.event_fail_at != 0)
+        CHECK(Volume->DiskIo2 == NULL, "Disk I/O 2 is used although it is not usable");
+    else
+        CHECK(Volume->DiskIo2 == &mock_DiskIo2, "Disk I/O 2 is not used");
+    
+    // sequential runs of 8 blocks
+    counters.read_disk = 0;
+    for (i = 0, bno = 1; i < 200 && bno + 8 <= nblocks; i++, bno += 8)
+        check_read(Volume, bno, 8);
+    sync_reads = counters.read_disk;
+    if (Volume->DiskIo2 != NULL && mode.submit_fail_every == 0 && mode.txn_fail_every == 0)
+        CHECK(sync_reads < 200 / 4, "sequential reads were not served by read-ahead");
+    
+    // runs longer than one read-ahead request
+    counters.read_disk_bytes = 0;
+    for (i = 0, bno = 3; i < 20 && bno + 3 * cap <= nblocks; i++, bno += 3 * cap)
+        check_read(Volume, bno, 3 * cap);
+    sync_bytes = counters.read_disk_bytes;
+    if (Volume->DiskIo2 != NULL && mode.submit_fail_every == 0 && mode.txn_fail_every == 0)
+        CHECK(sync_bytes < 20ULL * 3 * cap * vol->phys_blocksize / 2,
+              "long sequential runs were mostly read synchronously");
+    
+    // random jumps, re-reads and single blocks mixed with sequential streaks
+    for (i = 0, bno = 0, count = 1; i < 3000; i++) {
+        switch (next_rand() % 8) {
+            case 0:
+            case 1:
+                bno = next_rand() * 7919ULL % nblocks;
+                count = 1 + next_rand() % (2 * cap);
+                break;
+            case 2:
+                bno = (bno >= 2 * count) ? bno - 2 * count : 0;
+                break;
+            case 3:
+                count = 1;
+                break;
+            case 4:
+                bno = nblocks - 1 - next_rand() % (cap + 8);
+                count = 1 + next_rand() % 8;
+                break;
+            default:
+                break;
+        }
+        if (bno + count > nblocks)
+            count = (fsw_u32)(nblocks - bno);
+        check_read(Volume, bno, count);
+        bno += count;
+        if (bno >= nblocks)
+            bno = 0;
+    }
+    
+    // optionally read a file through the protocol interface
+    if (path != NULL)
+        check_file(Volume, path, ref_path);
+    
+    // leave read-ahead in flight for the unmount
+    check_read(Volume, 100, 4);
+    check_read(Volume, 104, 4);
+    if (Volume->DiskIo2 != NULL && mode.submit_fail_every != 1)
+        CHECK(op_count > 0, "no read-ahead in flight before Stop");
+    
+    Status = fsw_efi_DriverBinding_table.Stop(&fsw_efi_DriverBinding_table, &controller, 0, NULL);
+    CHECK(!EFI_ERROR(Status), "Stop failed");
+    CHECK(op_count == 0, "reads still queued after Stop");
+    CHECK(events_open() == 0, "events left open after Stop");
+    if (!mode.have_diskio2 || mode.event_fail_at != 0)
+        CHECK(counters.read_disk_ex == 0, "ReadDiskEx called without usable Disk I/O 2");
+    
+    printf("%s %-32s  sync %lu  async %lu (%lu failed)\n",
+           (failures == failures_before) ? "OK  " : "FAIL", name,
+           counters.read_disk, counters.read_disk_ex_submitted, counters.read_disk_ex_failed_txn);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        int order, have_diskio2, submit_fail_every, txn_fail_every, event_fail_at;
+    } passes[] = {
+        { "no Disk I/O 2",                  COMPLETE_FIFO, 0, 0, 0, 0 },
+        { "in order",                       COMPLETE_FIFO, 1, 0, 0, 0 },
+        { "out of order",                   COMPLETE_LIFO, 1, 0, 0, 0 },
+        { "in order, failing submit",       COMPLETE_FIFO, 1, 3, 0, 0 },
+        { "out of order, failing submit",   COMPLETE_LIFO, 1, 3, 0, 0 },
+        { "in order, all submits fail",     COMPLETE_FIFO, 1, 1, 0, 0 },
+        { "in order, failing transfer",     COMPLETE_FIFO, 1, 0, 4, 0 },
+        { "out of order, failing transfer", COMPLETE_LIFO, 1, 0, 4, 0 },
+        { "out of order, all transfers fail", COMPLETE_LIFO, 1, 0, 1, 0 },
+        { "CreateEvent fails",              COMPLETE_FIFO, 1, 0, 0, 3 },
+    };
+    EFI_HANDLE  image_handle = &image_handle;
+    struct stat st;
+    unsigned    i;
+    
+    if (argc != 2 && argc != 4) {
+        printf("Usage: efiasync <image> [<path> <reference file>]\n");
+        return 1;
+    }
+    image_fd = open(argv[1], O_RDONLY);
+    if (image_fd < 0 || fstat(image_fd, &st) < 0) {
+        printf("Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    image_size = st.st_size;
+    
+    mock_DiskIo.ReadDisk = mock_ReadDisk;
+    mock_DiskIo2.ReadDiskEx = mock_ReadDiskEx;
+    mock_Media.MediaId = MOCK_MEDIA_ID;
+    mock_BlockIo.Media = &mock_Media;
+    
+    if (EFI_ERROR(fsw_efi_main(image_handle, &mock_SystemTable))) {
+        printf("fsw_efi_main failed\n");
+        return 1;
+    }
+    
+    for (i = 0; i < sizeof(passes) / sizeof(passes[0]); i++) {
+        mode.complete_order     = passes[i].order;
+        mode.have_diskio2       = passes[i].have_diskio2;
+        mode.submit_fail_every  = passes[i].submit_fail_every;
+        mode.txn_fail_every     = passes[i].txn_fail_every;
+        mode.event_fail_at      = passes[i].event_fail_at;
+        run_pass(passes[i].name, (argc == 4) ? argv[2] : NULL, (argc == 4) ? argv[3] : NULL);
+    }
+    
+    close(image_fd);
+    if (failures) {
+        printf("%d check(s) failed.\n", failures);
+        return 1;
+    }
+    printf("All checks passed.\n");
+    return 0;
+}
+
+// EOF
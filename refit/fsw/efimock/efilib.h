@@ -0,0 +1,66 @@
+/**
+ * \file efilib.h
+ * Minimal stand-in for the EFI toolkit library header, used to build the FSW
+ * EFI host as a POSIX program for testing (see efiasync.c). The functions are
+ * implemented by the test program.
+ */
+
+/*-
+ * Copyright (c) 2006 Christoph Pfisterer
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *  * Neither the name of Christoph Pfisterer nor the names of the
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EFIMOCK_EFILIB_H_
+#define _EFIMOCK_EFILIB_H_
+
+#include "efi.h"
+
+
+VOID    InitializeLib(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable);
+
+VOID    *AllocatePool(UINTN Size);
+VOID    *AllocateZeroPool(UINTN Size);
+VOID    FreePool(VOID *Buffer);
+
+VOID    ZeroMem(VOID *Buffer, UINTN Size);
+VOID    CopyMem(VOID *Dest, VOID *Src, UINTN Size);
+INTN    CompareMem(VOID *Dest, VOID *Src, UINTN Size);
+INTN    CompareGuid(EFI_GUID *Guid1, EFI_GUID *Guid2);
+UINTN   StrLen(CHAR16 *s);
+
+UINTN   Print(CHAR16 *fmt, ...);
+
+UINT64  RShiftU64(UINT64 Operand, UINTN Count);
+UINT64  DivU64x32(UINT64 Dividend, UINTN Divisor, UINTN *Remainder);
+
+
+#endif
+
+// EOF
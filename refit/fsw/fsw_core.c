@@ -40,9 +40,45 @@
 
 // functions
 
+static fsw_status_t fsw_block_read_direct(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+static fsw_status_t fsw_shandle_readahead(struct fsw_shandle *shand, fsw_u64 phys_bno, fsw_u64 pos_in_extent);
+static struct fsw_blockcache * fsw_blockcache_lookup(struct fsw_volume *vol, fsw_u64 phys_bno);
+static fsw_status_t fsw_blockcache_alloc(struct fsw_volume *vol, struct fsw_blockcache **bc_out);
+static void fsw_blockcache_lru_unlink(struct fsw_volume *vol, struct fsw_blockcache *bc);
+static void fsw_blockcache_lru_append(struct fsw_volume *vol, struct fsw_blockcache *bc);
+static void fsw_blockcache_hash_unlink(struct fsw_volume *vol, struct fsw_blockcache *bc);
+static void fsw_blockcache_trim(struct fsw_volume *vol);
 static void fsw_blockcache_free(struct fsw_volume *vol);
+static fsw_u32 fsw_strhash(struct fsw_string *s, fsw_u32 seed);
+static fsw_u32 fsw_dcache_hash(struct fsw_dnode *dno, struct fsw_string *name);
+static struct fsw_dentry * fsw_dcache_lookup(struct fsw_volume *vol, struct fsw_dnode *dno, struct fsw_string *name);
+static void fsw_dcache_insert(struct fsw_volume *vol, struct fsw_dnode *dno, struct fsw_string *name,
+                              struct fsw_dnode *child_dno);
+static void fsw_dcache_evict(struct fsw_volume *vol, struct fsw_dentry *de);
+static void fsw_dcache_trim(struct fsw_volume *vol);
+static void fsw_dcache_hold(struct fsw_volume *vol, struct fsw_dnode *dno);
+static void fsw_dcache_drop(struct fsw_volume *vol, struct fsw_dnode *dno);
+static void fsw_dcache_free(struct fsw_volume *vol);
+static fsw_u32 fsw_dnode_hash_slot(struct fsw_volume *vol, fsw_u64 dnode_id);
+static fsw_status_t fsw_dnode_dir_lookup(struct fsw_dnode *dno,
+                                         struct fsw_string *lookup_name, struct fsw_dnode **child_dno_out);
+static fsw_status_t fsw_dir_index_build(struct fsw_dnode *dno);
+static fsw_status_t fsw_dir_index_add(struct fsw_dir_index *idx, fsw_u32 pos, struct fsw_string *name);
+static void fsw_dir_index_free(struct fsw_dir_index *idx);
+static struct fsw_dnode * fsw_dnode_find(struct fsw_volume *vol, fsw_u64 dnode_id);
+static fsw_status_t fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno);
+static void fsw_dnode_unregister(struct fsw_volume *vol, struct fsw_dnode *dno);
 
-#define MAX_CACHE_LEVEL (5)
+/** Hash bucket for a physical block number. Consecutive blocks land in consecutive buckets. */
+#define FSW_BCACHE_BUCKET(vol,phys_bno) ((vol)->bcache_hash[(fsw_u32)(phys_bno) & ((vol)->bcache_hash_size - 1)])
+/** Hash bucket for a directory lookup, given the hash value from fsw_dcache_hash. */
+#define FSW_DCACHE_BUCKET(vol,hash) ((vol)->dcache_hash[(hash) & ((vol)->dcache_hash_size - 1)])
+/** End marker for the hash chains of a directory index. */
+#define FSW_DIR_INDEX_END (0xffffffffUL)
+/** Divide a 64-bit file position by a block size. Positions below 4 GiB, the common case,
+    take a plain 32-bit division instead of the 64-bit helper. */
+#define FSW_POS_DIV(pos,divisor) ((fsw_u32)FSW_U64_SHR((pos), 32) ? (fsw_u32)FSW_U64_DIV((pos), (divisor)) \
+                                                                   : (fsw_u32)(pos) / (divisor))
 
 
 /**
@@ -80,6 +116,8 @@ fsw_status_t fsw_mount(void *host_data,
     vol->host_table     = host_table;
     vol->fstype_table   = fstype_table;
     vol->host_string_type = host_table->native_string_type;
+    fsw_set_bcache_budget(vol, host_table->bcache_budget);
+    fsw_set_readahead(vol, FSW_READAHEAD_DEFAULT_SIZE);
     
     // let the fs driver mount the file system
     status = vol->fstype_table->volume_mount(vol);
@@ -106,6 +144,7 @@ errorexit:
 
 void fsw_unmount(struct fsw_volume *vol)
 {
+    fsw_dcache_free(vol);
     if (vol->root)
         fsw_dnode_release(vol->root);
     // TODO: check that no other dnodes are still around
@@ -113,6 +152,8 @@ void fsw_unmount(struct fsw_volume *vol)
     vol->fstype_table->volume_free(vol);
     
     fsw_blockcache_free(vol);
+    if (vol->dnode_hash != NULL)
+        fsw_free(vol->dnode_hash);
     fsw_strfree(&vol->label);
     fsw_free(vol);
 }
@@ -157,6 +198,66 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
     
     vol->phys_blocksize = phys_blocksize;
     vol->log_blocksize = log_blocksize;
+    
+    // the number of blocks that fit into the budget depends on the block size
+    fsw_set_bcache_budget(vol, vol->bcache_budget);
+}
+
+/**
+ * Set the memory budget for the volume's block cache. This function is called by the
+ * core while mounting with the budget from the host table, and may be called by the
+ * host driver later to change the budget of a mounted volume. A budget of zero selects
+ * FSW_BCACHE_DEFAULT_BUDGET.
+ *
+ * The budget limits the memory used for block buffers. Unreferenced blocks are freed
+ * as soon as the cache grows beyond the budget. Blocks that are currently referenced
+ * are never discarded, so the cache may temporarily exceed the budget. The cache
+ * always keeps at least FSW_BCACHE_MIN_SIZE blocks.
+ *
+ * One FSW_DCACHE_BUDGET_SHARE-th of the budget is set aside for the directory entry
+ * cache, which remembers the results of directory lookups.
+ */
+
+void fsw_set_bcache_budget(struct fsw_volume *vol, fsw_u32 budget)
+{
+    if (budget == 0)
+        budget = FSW_BCACHE_DEFAULT_BUDGET;
+    vol->bcache_budget = budget;
+    vol->dcache_budget = budget / FSW_DCACHE_BUDGET_SHARE;
+    vol->bcache_size = (budget - vol->dcache_budget) / vol->phys_blocksize;
+    if (vol->bcache_size < FSW_BCACHE_MIN_SIZE)
+        vol->bcache_size = FSW_BCACHE_MIN_SIZE;
+    
+    fsw_blockcache_trim(vol);
+    fsw_dcache_trim(vol);
+}
+
+/**
+ * Set the read-ahead window for sequential reads of file data on a volume. This function
+ * is called by the core while mounting with FSW_READAHEAD_DEFAULT_SIZE, and may be called
+ * by the host driver later to tune a mounted volume for its device. A window smaller than
+ * two physical blocks disables read-ahead.
+ *
+ * Shandles that already have a read-ahead buffer resize it on their next fill.
+ */
+
+void fsw_set_readahead(struct fsw_volume *vol, fsw_u32 readahead_size)
+{
+    vol->readahead_size = readahead_size;
+}
+
+/**
+ * Get the read-ahead statistics of a volume. This function can be called by the host
+ * driver to judge how well the read-ahead window suits the device. The ratio of blocks
+ * hit to blocks read shows how much of the data read ahead was actually used.
+ */
+
+void fsw_get_readahead_stat(struct fsw_volume *vol, struct fsw_readahead_stat *sb)
+{
+    sb->window_bytes = vol->readahead_size;
+    sb->fills = vol->readahead_fills;
+    sb->blocks_read = vol->readahead_blocks;
+    sb->blocks_hit = vol->readahead_hits;
 }
 
 /**
@@ -172,109 +273,294 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
  *  - 2: File system metadata
  *  - 3..5: File system metadata with a high rate of access
  *
+ * Cached blocks are found through a hash table keyed on the physical block number.
+ * Blocks that are not currently referenced are kept on one LRU list per cache level;
+ * when an entry must be reused, the least recently released block of the lowest
+ * non-empty level is chosen. All of these operations take constant time. The cache
+ * grows until it reaches the volume's memory budget (see fsw_set_bcache_budget),
+ * after that buffers are recycled.
+ *
+ * Host drivers that can hand out block data without copying it (e.g. from a memory
+ * mapping of the device) provide the optional block_get function in the host table.
+ * Requests are passed through to it first; the core's cache is only used for blocks
+ * the host declines with FSW_UNSUPPORTED.
+ *
  * If this function returns successfully, the returned data pointer is valid until the
- * caller calls fsw_block_release.
+ * caller calls fsw_block_release. The caller must not modify the data.
  */
 
-fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out)
+fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out)
 {
     fsw_status_t    status;
-    fsw_u32         i, discard_level, new_bcache_size;
-    struct fsw_blockcache *new_bcache;
+    fsw_u32         discard_level;
+    struct fsw_blockcache *bc;
     
-    // TODO: allow the host driver to do its own caching; just call through if
-    //  the appropriate function pointers are set
+    // let the host driver do its own caching if it wants to
+    if (vol->host_table->block_get != NULL) {
+        status = vol->host_table->block_get(vol, phys_bno, cache_level, buffer_out);
+        if (status != FSW_UNSUPPORTED)
+            return status;
+    }
     
-    if (cache_level > MAX_CACHE_LEVEL)
-        cache_level = MAX_CACHE_LEVEL;
+    if (cache_level > FSW_MAX_CACHE_LEVEL)
+        cache_level = FSW_MAX_CACHE_LEVEL;
     
     // check block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno) {
-            // cache hit!
-            if (vol->bcache[i].cache_level < cache_level)
-                vol->bcache[i].cache_level = cache_level;  // promote the entry
-            vol->bcache[i].refcount++;
-            *buffer_out = vol->bcache[i].data;
-            return FSW_SUCCESS;
-        }
+    bc = fsw_blockcache_lookup(vol, phys_bno);
+    if (bc != NULL) {
+        // cache hit!
+        if (bc->refcount == 0)
+            fsw_blockcache_lru_unlink(vol, bc);
+        if (bc->cache_level < cache_level)
+            bc->cache_level = cache_level;  // promote the entry
+        bc->refcount++;
+        *buffer_out = bc->data;
+        return FSW_SUCCESS;
     }
     
-    // find a free entry in the cache table
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == FSW_INVALID_BNO)
-            break;
-    }
-    if (i >= vol->bcache_size) {
-        for (discard_level = 0; discard_level <= MAX_CACHE_LEVEL; discard_level++) {
-            for (i = 0; i < vol->bcache_size; i++) {
-                if (vol->bcache[i].refcount == 0 && vol->bcache[i].cache_level <= discard_level)
-                    break;
-            }
-            if (i < vol->bcache_size)
+    // get an entry: unused ones first, then allocate up to the budget,
+    //  then discard the least recently used block of the lowest level
+    bc = vol->bcache_free;
+    if (bc != NULL) {
+        vol->bcache_free = bc->hash_next;
+    } else if (vol->bcache_count < vol->bcache_size) {
+        status = fsw_blockcache_alloc(vol, &bc);
+        if (status)
+            return status;
+    } else {
+        for (discard_level = 0; discard_level <= FSW_MAX_CACHE_LEVEL; discard_level++) {
+            bc = vol->bcache_lru_head[discard_level];
+            if (bc != NULL)
                 break;
         }
+        if (bc != NULL) {
+            fsw_blockcache_lru_unlink(vol, bc);
+            fsw_blockcache_hash_unlink(vol, bc);
+        } else {
+            // all blocks are in use, go over the budget until some are released
+            status = fsw_blockcache_alloc(vol, &bc);
+            if (status)
+                return status;
+        }
     }
-    if (i >= vol->bcache_size) {
-        // enlarge / create the cache
-        if (vol->bcache_size < 16)
-            new_bcache_size = 16;
-        else
-            new_bcache_size = vol->bcache_size << 1;
-        status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
-        if (status)
+    bc->phys_bno = FSW_INVALID_BNO;
+    
+    // read the data
+    if (bc->data == NULL) {
+        status = fsw_alloc(vol->phys_blocksize, &bc->data);
+        if (status) {
+            bc->hash_next = vol->bcache_free;
+            vol->bcache_free = bc;
             return status;
-        if (vol->bcache_size > 0)
-            fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache));
-        for (i = vol->bcache_size; i < new_bcache_size; i++) {
-            new_bcache[i].refcount = 0;
-            new_bcache[i].cache_level = 0;
-            new_bcache[i].phys_bno = FSW_INVALID_BNO;
-            new_bcache[i].data = NULL;
         }
-        i = vol->bcache_size;
-        
-        // switch caches
-        if (vol->bcache != NULL)
-            fsw_free(vol->bcache);
-        vol->bcache = new_bcache;
-        vol->bcache_size = new_bcache_size;
     }
-    vol->bcache[i].phys_bno = FSW_INVALID_BNO;
+    status = vol->host_table->read_block(vol, phys_bno, bc->data);
+    if (status) {
+        bc->hash_next = vol->bcache_free;
+        vol->bcache_free = bc;
+        return status;
+    }
     
-    // read the data
-    if (vol->bcache[i].data == NULL) {
-        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
+    bc->phys_bno = phys_bno;
+    bc->cache_level = cache_level;
+    bc->refcount = 1;
+    bc->hash_next = FSW_BCACHE_BUCKET(vol, phys_bno);
+    FSW_BCACHE_BUCKET(vol, phys_bno) = bc;
+    *buffer_out = bc->data;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Releases a disk block. This function must be called to release disk blocks returned
+ * from fsw_block_get.
+ */
+
+void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer)
+{
+    struct fsw_blockcache *bc;
+    
+    // update block cache
+    bc = fsw_blockcache_lookup(vol, phys_bno);
+    if (bc != NULL && bc->refcount > 0 && bc->data == buffer) {
+        bc->refcount--;
+        if (bc->refcount == 0) {
+            fsw_blockcache_lru_append(vol, bc);
+            if (vol->bcache_count > vol->bcache_size)
+                fsw_blockcache_trim(vol);
+        }
+        return;
+    }
+    
+    // not from the core's cache, the host driver handed it out
+    if (vol->host_table->block_release != NULL)
+        vol->host_table->block_release(vol, phys_bno, buffer);
+}
+
+/**
+ * Read a run of consecutive disk blocks into a caller-provided buffer, bypassing the
+ * block cache. This is used for file data that covers whole physical blocks. If the host
+ * driver provides the optional read_blocks function, the whole run is read with one call,
+ * otherwise the blocks are read one by one with read_block.
+ */
+
+static fsw_status_t fsw_block_read_direct(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer)
+{
+    fsw_status_t    status;
+    fsw_u32         i;
+    
+    if (vol->host_table->read_blocks != NULL)
+        return vol->host_table->read_blocks(vol, phys_bno, count, buffer);
+    
+    for (i = 0; i < count; i++) {
+        status = vol->host_table->read_block(vol, phys_bno + i,
+                                             (fsw_u8 *)buffer + i * vol->phys_blocksize);
         if (status)
             return status;
     }
-    status = vol->host_table->read_block(vol, phys_bno, vol->bcache[i].data);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Find a block in the block cache. Returns the cache entry or NULL if the block
+ * is not cached.
+ */
+
+static struct fsw_blockcache * fsw_blockcache_lookup(struct fsw_volume *vol, fsw_u64 phys_bno)
+{
+    struct fsw_blockcache *bc;
+    
+    if (vol->bcache_hash == NULL)
+        return NULL;
+    for (bc = FSW_BCACHE_BUCKET(vol, phys_bno); bc; bc = bc->hash_next) {
+        if (bc->phys_bno == phys_bno)
+            return bc;
+    }
+    return NULL;
+}
+
+/**
+ * Allocate a new, empty block cache entry. The hash table is enlarged as needed
+ * to keep the average chain length below two entries.
+ */
+
+static fsw_status_t fsw_blockcache_alloc(struct fsw_volume *vol, struct fsw_blockcache **bc_out)
+{
+    fsw_status_t    status;
+    fsw_u32         i, old_hash_size;
+    struct fsw_blockcache **old_hash, *bc, *next_bc;
+    
+    if (vol->bcache_hash == NULL || vol->bcache_count >= (vol->bcache_hash_size << 1)) {
+        // rehash into a table twice the size
+        old_hash = vol->bcache_hash;
+        old_hash_size = vol->bcache_hash_size;
+        vol->bcache_hash_size = (old_hash_size < 16) ? 16 : (old_hash_size << 1);
+        status = fsw_alloc_zero(vol->bcache_hash_size * sizeof(struct fsw_blockcache *),
+                                (void **)&vol->bcache_hash);
+        if (status) {
+            vol->bcache_hash = old_hash;
+            vol->bcache_hash_size = old_hash_size;
+            return status;
+        }
+        for (i = 0; i < old_hash_size; i++) {
+            for (bc = old_hash[i]; bc; bc = next_bc) {
+                next_bc = bc->hash_next;
+                bc->hash_next = FSW_BCACHE_BUCKET(vol, bc->phys_bno);
+                FSW_BCACHE_BUCKET(vol, bc->phys_bno) = bc;
+            }
+        }
+        if (old_hash != NULL)
+            fsw_free(old_hash);
+    }
+    
+    status = fsw_alloc_zero(sizeof(struct fsw_blockcache), (void **)&bc);
     if (status)
         return status;
+    bc->phys_bno = FSW_INVALID_BNO;
+    vol->bcache_count++;
     
-    vol->bcache[i].phys_bno = phys_bno;
-    vol->bcache[i].cache_level = cache_level;
-    vol->bcache[i].refcount = 1;
-    *buffer_out = vol->bcache[i].data;
+    *bc_out = bc;
     return FSW_SUCCESS;
 }
 
 /**
- * Releases a disk block. This function must be called to release disk blocks returned
- * from fsw_block_get.
+ * Remove a block cache entry from the LRU list of its cache level. Only entries
+ * with a reference count of zero are kept on the LRU lists.
+ */
+
+static void fsw_blockcache_lru_unlink(struct fsw_volume *vol, struct fsw_blockcache *bc)
+{
+    if (bc->lru_prev)
+        bc->lru_prev->lru_next = bc->lru_next;
+    else
+        vol->bcache_lru_head[bc->cache_level] = bc->lru_next;
+    if (bc->lru_next)
+        bc->lru_next->lru_prev = bc->lru_prev;
+    else
+        vol->bcache_lru_tail[bc->cache_level] = bc->lru_prev;
+    bc->lru_next = bc->lru_prev = NULL;
+}
+
+/**
+ * Append a block cache entry to the LRU list of its cache level, making it the
+ * most recently used unreferenced entry of that level.
+ */
+
+static void fsw_blockcache_lru_append(struct fsw_volume *vol, struct fsw_blockcache *bc)
+{
+    bc->lru_next = NULL;
+    bc->lru_prev = vol->bcache_lru_tail[bc->cache_level];
+    if (bc->lru_prev)
+        bc->lru_prev->lru_next = bc;
+    else
+        vol->bcache_lru_head[bc->cache_level] = bc;
+    vol->bcache_lru_tail[bc->cache_level] = bc;
+}
+
+/**
+ * Remove a block cache entry from the hash table.
  */
 
-void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer)
+static void fsw_blockcache_hash_unlink(struct fsw_volume *vol, struct fsw_blockcache *bc)
 {
-    fsw_u32 i;
+    struct fsw_blockcache **link;
     
-    // TODO: allow the host driver to do its own caching; just call through if
-    //  the appropriate function pointers are set
+    for (link = &FSW_BCACHE_BUCKET(vol, bc->phys_bno); *link; link = &(*link)->hash_next) {
+        if (*link == bc) {
+            *link = bc->hash_next;
+            break;
+        }
+    }
+    bc->hash_next = NULL;
+}
+
+/**
+ * Shrink the block cache down to the volume's budget. Unused entries are freed
+ * first, then unreferenced blocks in the same order fsw_block_get would discard them.
+ */
+
+static void fsw_blockcache_trim(struct fsw_volume *vol)
+{
+    fsw_u32         discard_level;
+    struct fsw_blockcache *bc;
     
-    // update block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno && vol->bcache[i].refcount > 0)
-            vol->bcache[i].refcount--;
+    for (discard_level = 0; vol->bcache_count > vol->bcache_size; ) {
+        bc = vol->bcache_free;
+        if (bc != NULL) {
+            vol->bcache_free = bc->hash_next;
+        } else {
+            while (discard_level <= FSW_MAX_CACHE_LEVEL && vol->bcache_lru_head[discard_level] == NULL)
+                discard_level++;
+            if (discard_level > FSW_MAX_CACHE_LEVEL)
+                break;   // everything left is referenced
+            bc = vol->bcache_lru_head[discard_level];
+            fsw_blockcache_lru_unlink(vol, bc);
+            fsw_blockcache_hash_unlink(vol, bc);
+        }
+        
+        if (bc->data != NULL)
+            fsw_free(bc->data);
+        fsw_free(bc);
+        vol->bcache_count--;
     }
 }
 
@@ -285,32 +571,375 @@ void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer
 
 static void fsw_blockcache_free(struct fsw_volume *vol)
 {
-    fsw_u32 i;
+    fsw_u32 i, level;
+    struct fsw_blockcache *bc, *next_bc;
+    
+    for (i = 0; i < vol->bcache_hash_size; i++) {
+        for (bc = vol->bcache_hash[i]; bc; bc = next_bc) {
+            next_bc = bc->hash_next;
+            if (bc->data != NULL)
+                fsw_free(bc->data);
+            fsw_free(bc);
+        }
+    }
+    for (bc = vol->bcache_free; bc; bc = next_bc) {
+        next_bc = bc->hash_next;
+        if (bc->data != NULL)
+            fsw_free(bc->data);
+        fsw_free(bc);
+    }
+    if (vol->bcache_hash != NULL) {
+        fsw_free(vol->bcache_hash);
+        vol->bcache_hash = NULL;
+    }
+    vol->bcache_hash_size = 0;
+    vol->bcache_free = NULL;
+    for (level = 0; level <= FSW_MAX_CACHE_LEVEL; level++)
+        vol->bcache_lru_head[level] = vol->bcache_lru_tail[level] = NULL;
+    vol->bcache_count = 0;
+}
+
+/**
+ * Compute a hash value for a string. The string is hashed byte by byte, so this
+ * only gives matching values for strings in the same string type.
+ */
+
+static fsw_u32 fsw_strhash(struct fsw_string *s, fsw_u32 seed)
+{
+    fsw_u32         h;
+    int             i;
+    fsw_u8          *p = (fsw_u8 *)s->data;
+    
+    h = 2166136261UL ^ seed;
+    for (i = 0; i < s->size; i++)
+        h = (h ^ p[i]) * 16777619UL;
+    return h ^ (h >> 16);
+}
+
+/**
+ * Compute the hash value of a directory lookup.
+ */
+
+static fsw_u32 fsw_dcache_hash(struct fsw_dnode *dno, struct fsw_string *name)
+{
+    return fsw_strhash(name, (fsw_u32)dno->dnode_id ^ (fsw_u32)FSW_U64_SHR(dno->dnode_id, 32));
+}
+
+/**
+ * Find a cached result for looking up a name in a directory. Returns NULL if the
+ * lookup is not in the cache. A hit moves the entry to the end of the LRU list.
+ */
+
+static struct fsw_dentry * fsw_dcache_lookup(struct fsw_volume *vol, struct fsw_dnode *dno, struct fsw_string *name)
+{
+    struct fsw_dentry *de;
+    
+    if (vol->dcache_hash == NULL || name->type != vol->host_string_type)
+        return NULL;
+    
+    for (de = FSW_DCACHE_BUCKET(vol, fsw_dcache_hash(dno, name)); de; de = de->hash_next) {
+        if (de->parent == dno && de->name.size == name->size &&
+            fsw_memeq(de->name.data, name->data, name->size))
+            break;
+    }
+    if (de == NULL)
+        return NULL;
+    
+    // move to the most recently used end of the LRU list
+    if (de != vol->dcache_lru_tail) {
+        if (de->lru_prev)
+            de->lru_prev->lru_next = de->lru_next;
+        else
+            vol->dcache_lru_head = de->lru_next;
+        de->lru_next->lru_prev = de->lru_prev;
+        de->lru_next = NULL;
+        de->lru_prev = vol->dcache_lru_tail;
+        vol->dcache_lru_tail->lru_next = de;
+        vol->dcache_lru_tail = de;
+    }
+    return de;
+}
+
+/**
+ * Remember the result of looking up a name in a directory. If child_dno is NULL, a
+ * negative entry is created. The entry retains both dnodes, so the parent pointer
+ * stays valid as a key. Names in another string type than the host's are not cached.
+ * Failure to allocate the entry is not an error, the lookup just stays uncached.
+ *
+ * The entry itself and the child's structure are charged to the entry. What the
+ * dnodes own beyond that is charged through fsw_dcache_hold while the cache keeps them.
+ */
+
+static void fsw_dcache_insert(struct fsw_volume *vol, struct fsw_dnode *dno, struct fsw_string *name,
+                              struct fsw_dnode *child_dno)
+{
+    fsw_status_t    status;
+    fsw_u32         i, hash, old_hash_size;
+    struct fsw_dentry **old_hash, *de, *next_de;
+    
+    if (name->type != vol->host_string_type || name->size == 0 || vol->dcache_budget == 0)
+        return;
     
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].data != NULL)
-            fsw_free(vol->bcache[i].data);
+    if (vol->dcache_hash == NULL || vol->dcache_count >= (vol->dcache_hash_size << 1)) {
+        // rehash into a table twice the size
+        old_hash = vol->dcache_hash;
+        old_hash_size = vol->dcache_hash_size;
+        vol->dcache_hash_size = (old_hash_size < 16) ? 16 : (old_hash_size << 1);
+        status = fsw_alloc_zero(vol->dcache_hash_size * sizeof(struct fsw_dentry *),
+                                (void **)&vol->dcache_hash);
+        if (status) {
+            vol->dcache_hash = old_hash;
+            vol->dcache_hash_size = old_hash_size;
+            return;
+        }
+        for (i = 0; i < old_hash_size; i++) {
+            for (de = old_hash[i]; de; de = next_de) {
+                next_de = de->hash_next;
+                hash = fsw_dcache_hash(de->parent, &de->name);
+                de->hash_next = FSW_DCACHE_BUCKET(vol, hash);
+                FSW_DCACHE_BUCKET(vol, hash) = de;
+            }
+        }
+        if (old_hash != NULL)
+            fsw_free(old_hash);
+    }
+    
+    status = fsw_alloc_zero(sizeof(struct fsw_dentry), (void **)&de);
+    if (status)
+        return;
+    status = fsw_strdup_coerce(&de->name, name->type, name);
+    if (status) {
+        fsw_free(de);
+        return;
     }
-    if (vol->bcache != NULL) {
-        fsw_free(vol->bcache);
-        vol->bcache = NULL;
+    de->parent = dno;
+    fsw_dcache_hold(vol, dno);
+    de->child = child_dno;
+    de->size = sizeof(struct fsw_dentry) + de->name.size;
+    if (child_dno != NULL) {
+        fsw_dcache_hold(vol, child_dno);
+        de->size += vol->fstype_table->dnode_struct_size;
+    }
+    
+    // link into the hash table and at the end of the LRU list
+    hash = fsw_dcache_hash(dno, name);
+    de->hash_next = FSW_DCACHE_BUCKET(vol, hash);
+    FSW_DCACHE_BUCKET(vol, hash) = de;
+    de->lru_prev = vol->dcache_lru_tail;
+    if (de->lru_prev)
+        de->lru_prev->lru_next = de;
+    else
+        vol->dcache_lru_head = de;
+    vol->dcache_lru_tail = de;
+    vol->dcache_count++;
+    vol->dcache_used += de->size;
+    
+    fsw_dcache_trim(vol);
+}
+
+/**
+ * Remove an entry from the directory entry cache and free it. This releases the
+ * dnodes held by the entry, which may free them.
+ */
+
+static void fsw_dcache_evict(struct fsw_volume *vol, struct fsw_dentry *de)
+{
+    struct fsw_dentry **link;
+    
+    for (link = &FSW_DCACHE_BUCKET(vol, fsw_dcache_hash(de->parent, &de->name)); *link; link = &(*link)->hash_next) {
+        if (*link == de) {
+            *link = de->hash_next;
+            break;
+        }
+    }
+    if (de->lru_prev)
+        de->lru_prev->lru_next = de->lru_next;
+    else
+        vol->dcache_lru_head = de->lru_next;
+    if (de->lru_next)
+        de->lru_next->lru_prev = de->lru_prev;
+    else
+        vol->dcache_lru_tail = de->lru_prev;
+    vol->dcache_count--;
+    vol->dcache_used -= de->size;
+    
+    if (de->child != NULL)
+        fsw_dcache_drop(vol, de->child);
+    fsw_dcache_drop(vol, de->parent);
+    fsw_strfree(&de->name);
+    fsw_free(de);
+}
+
+/**
+ * Retain a dnode for the directory entry cache. While the cache holds a dnode, the
+ * memory the dnode owns is charged to the cache's budget, once per dnode.
+ */
+
+static void fsw_dcache_hold(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    fsw_dnode_retain(dno);
+    if (dno->dcache_refs++ == 0)
+        vol->dcache_used += dno->owned_size;
+}
+
+/**
+ * Release a dnode held by the directory entry cache, undoing fsw_dcache_hold.
+ */
+
+static void fsw_dcache_drop(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    if (--dno->dcache_refs == 0)
+        vol->dcache_used -= dno->owned_size;
+    fsw_dnode_release(dno);
+}
+
+/**
+ * Shrink the directory entry cache down to its budget, discarding the least
+ * recently used entries first.
+ */
+
+static void fsw_dcache_trim(struct fsw_volume *vol)
+{
+    while (vol->dcache_used > vol->dcache_budget && vol->dcache_lru_head != NULL)
+        fsw_dcache_evict(vol, vol->dcache_lru_head);
+}
+
+/**
+ * Release the directory entry cache. Called internally when unmounting the volume,
+ * before the root dnode is released.
+ */
+
+static void fsw_dcache_free(struct fsw_volume *vol)
+{
+    while (vol->dcache_lru_head != NULL)
+        fsw_dcache_evict(vol, vol->dcache_lru_head);
+    if (vol->dcache_hash != NULL) {
+        fsw_free(vol->dcache_hash);
+        vol->dcache_hash = NULL;
+    }
+    vol->dcache_hash_size = 0;
+}
+
+/**
+ * Compute the home slot of a dnode id in the volume's dnode hash table. The id is
+ * scrambled first because some file systems hand out ids with large strides. The high
+ * half of 64-bit ids is folded in.
+ */
+
+static fsw_u32 fsw_dnode_hash_slot(struct fsw_volume *vol, fsw_u64 dnode_id)
+{
+    fsw_u32         h;
+    
+    h = ((fsw_u32)dnode_id ^ (fsw_u32)FSW_U64_SHR(dnode_id, 32)) * 0x9E3779B1UL;
+    h ^= h >> 16;
+    return h & (vol->dnode_hash_size - 1);
+}
+
+/**
+ * Find a dnode by id in the volume's dnode hash table. Returns NULL if there is
+ * no dnode with that id on record. The reference count is not changed.
+ */
+
+static struct fsw_dnode * fsw_dnode_find(struct fsw_volume *vol, fsw_u64 dnode_id)
+{
+    fsw_u32         i;
+    struct fsw_dnode *dno;
+    
+    if (vol->dnode_hash == NULL)
+        return NULL;
+    
+    // linear probing, the table is never more than half full
+    for (i = fsw_dnode_hash_slot(vol, dnode_id); (dno = vol->dnode_hash[i]) != NULL;
+         i = (i + 1) & (vol->dnode_hash_size - 1)) {
+        if (dno->dnode_id == dnode_id)
+            return dno;
     }
-    vol->bcache_size = 0;
+    return NULL;
 }
 
 /**
- * Add a new dnode to the list of known dnodes. This internal function is used when a
- * dnode is created to add it to the dnode list that is used to search for existing
- * dnodes by id.
+ * Add a new dnode to the hash table and the list of known dnodes. This internal
+ * function is used when a dnode is created. The hash table is used to search for
+ * existing dnodes by id, the list is only kept for walking all dnodes of the volume.
+ * The hash table is doubled in size when it would become more than half full.
  */
 
-static void fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
+static fsw_status_t fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
 {
+    fsw_status_t    status;
+    fsw_u32         i, j, old_hash_size;
+    struct fsw_dnode **old_hash;
+    
+    if (vol->dnode_hash == NULL || ((vol->dnode_count + 1) << 1) > vol->dnode_hash_size) {
+        // rehash into a table twice the size
+        old_hash = vol->dnode_hash;
+        old_hash_size = vol->dnode_hash_size;
+        vol->dnode_hash_size = (old_hash_size < 64) ? 64 : (old_hash_size << 1);
+        status = fsw_alloc_zero(vol->dnode_hash_size * sizeof(struct fsw_dnode *),
+                                (void **)&vol->dnode_hash);
+        if (status) {
+            vol->dnode_hash = old_hash;
+            vol->dnode_hash_size = old_hash_size;
+            return status;
+        }
+        for (i = 0; i < old_hash_size; i++) {
+            if (old_hash[i] == NULL)
+                continue;
+            for (j = fsw_dnode_hash_slot(vol, old_hash[i]->dnode_id); vol->dnode_hash[j] != NULL;
+                 j = (j + 1) & (vol->dnode_hash_size - 1)) ;
+            vol->dnode_hash[j] = old_hash[i];
+        }
+        if (old_hash != NULL)
+            fsw_free(old_hash);
+    }
+    
+    // insert into the hash table
+    for (i = fsw_dnode_hash_slot(vol, dno->dnode_id); vol->dnode_hash[i] != NULL;
+         i = (i + 1) & (vol->dnode_hash_size - 1)) ;
+    vol->dnode_hash[i] = dno;
+    vol->dnode_count++;
+    
+    // link into the list
     dno->next = vol->dnode_head;
     if (vol->dnode_head != NULL)
         vol->dnode_head->prev = dno;
     dno->prev = NULL;
     vol->dnode_head = dno;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Remove a dnode from the hash table and the list of known dnodes. The probe
+ * sequence is repaired by shifting following entries back into the freed slot,
+ * so the table never accumulates deleted markers.
+ */
+
+static void fsw_dnode_unregister(struct fsw_volume *vol, struct fsw_dnode *dno)
+{
+    fsw_u32         i, j, home, mask;
+    
+    mask = vol->dnode_hash_size - 1;
+    for (i = fsw_dnode_hash_slot(vol, dno->dnode_id); vol->dnode_hash[i] != dno; i = (i + 1) & mask) ;
+    vol->dnode_hash[i] = NULL;
+    vol->dnode_count--;
+    
+    for (j = (i + 1) & mask; vol->dnode_hash[j] != NULL; j = (j + 1) & mask) {
+        // move the entry at j into the hole at i unless its home slot lies between them
+        home = fsw_dnode_hash_slot(vol, vol->dnode_hash[j]->dnode_id);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            vol->dnode_hash[i] = vol->dnode_hash[j];
+            vol->dnode_hash[j] = NULL;
+            i = j;
+        }
+    }
+    
+    // unlink from the list
+    if (dno->next)
+        dno->next->prev = dno->prev;
+    if (dno->prev)
+        dno->prev->next = dno->next;
+    if (vol->dnode_head == dno)
+        vol->dnode_head = dno->next;
 }
 
 /**
@@ -320,7 +949,7 @@ static void fsw_dnode_register(struct fsw_volume *vol, struct fsw_dnode *dno)
  * behaves in the same way as fsw_dnode_create.
  */
 
-fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u32 dnode_id, struct fsw_dnode **dno_out)
+fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u64 dnode_id, struct fsw_dnode **dno_out)
 {
     fsw_status_t    status;
     struct fsw_dnode *dno;
@@ -339,7 +968,11 @@ fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u32 dnode_id, str
     dno->name.type = FSW_STRING_TYPE_EMPTY;
     // TODO: instead, call a function to create an empty string in the native string type
     
-    fsw_dnode_register(vol, dno);
+    status = fsw_dnode_register(vol, dno);
+    if (status) {
+        fsw_free(dno);
+        return status;
+    }
     
     *dno_out = dno;
     return FSW_SUCCESS;
@@ -353,7 +986,9 @@ fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u32 dnode_id, str
  * increased. All other parameters are ignored in this case.
  *
  * The type passed into this function may be FSW_DNODE_TYPE_UNKNOWN. It is sufficient
- * to fill the type field during the dnode_fill call.
+ * to fill the type field during the dnode_fill call. File systems that record the type
+ * in their directory entries should pass it in, so hosts that only need the type can
+ * skip fsw_dnode_fill.
  *
  * The name parameter must describe a string with the object's name. A copy will be
  * stored in the dnode structure for future reference. The name will not be used to
@@ -363,7 +998,7 @@ fsw_status_t fsw_dnode_create_root(struct fsw_volume *vol, fsw_u32 dnode_id, str
  * that must be released by the caller with fsw_dnode_release.
  */
 
-fsw_status_t fsw_dnode_create(struct fsw_dnode *parent_dno, fsw_u32 dnode_id, int type,
+fsw_status_t fsw_dnode_create(struct fsw_dnode *parent_dno, fsw_u64 dnode_id, int type,
                               struct fsw_string *name, struct fsw_dnode **dno_out)
 {
     fsw_status_t    status;
@@ -371,12 +1006,11 @@ fsw_status_t fsw_dnode_create(struct fsw_dnode *parent_dno, fsw_u32 dnode_id, in
     struct fsw_dnode *dno;
     
     // check if we already have a dnode with the same id
-    for (dno = vol->dnode_head; dno; dno = dno->next) {
-        if (dno->dnode_id == dnode_id) {
-            fsw_dnode_retain(dno);
-            *dno_out = dno;
-            return FSW_SUCCESS;
-        }
+    dno = fsw_dnode_find(vol, dnode_id);
+    if (dno != NULL) {
+        fsw_dnode_retain(dno);
+        *dno_out = dno;
+        return FSW_SUCCESS;
     }
     
     // allocate memory for the structure
@@ -393,11 +1027,18 @@ fsw_status_t fsw_dnode_create(struct fsw_dnode *parent_dno, fsw_u32 dnode_id, in
     dno->refcount = 1;
     status = fsw_strdup_coerce(&dno->name, vol->host_table->native_string_type, name);
     if (status) {
+        fsw_dnode_release(dno->parent);
         fsw_free(dno);
         return status;
     }
     
-    fsw_dnode_register(vol, dno);
+    status = fsw_dnode_register(vol, dno);
+    if (status) {
+        fsw_strfree(&dno->name);
+        fsw_dnode_release(dno->parent);
+        fsw_free(dno);
+        return status;
+    }
     
     *dno_out = dno;
     return FSW_SUCCESS;
@@ -414,6 +1055,26 @@ void fsw_dnode_retain(struct fsw_dnode *dno)
     dno->refcount++;
 }
 
+/**
+ * Record a change in the memory that a dnode owns beyond its structure, such as
+ * a file system driver's block map or the core's directory index. The file system
+ * driver calls this with the old and new size whenever it allocates, grows or frees
+ * such memory. If the directory entry cache holds the dnode, the change is charged
+ * to the cache's budget, and growth may evict cache entries.
+ */
+
+void fsw_dnode_account(struct fsw_dnode *dno, fsw_u32 old_size, fsw_u32 new_size)
+{
+    struct fsw_volume *vol = dno->vol;
+    
+    dno->owned_size += new_size - old_size;
+    if (dno->dcache_refs > 0) {
+        vol->dcache_used += new_size - old_size;
+        if (new_size > old_size)
+            fsw_dcache_trim(vol);
+    }
+}
+
 /**
  * Release a dnode pointer, deallocating it if this was the last reference.
  * This function decrements the reference counter of the dnode. If the counter
@@ -431,17 +1092,15 @@ void fsw_dnode_release(struct fsw_dnode *dno)
     if (dno->refcount == 0) {
         parent_dno = dno->parent;
         
-        // de-register from volume's list
-        if (dno->next)
-            dno->next->prev = dno->prev;
-        if (dno->prev)
-            dno->prev->next = dno->next;
-        if (vol->dnode_head == dno)
-            vol->dnode_head = dno->next;
+        // de-register from volume's hash table and list
+        fsw_dnode_unregister(vol, dno);
         
         // run fstype-specific cleanup
         vol->fstype_table->dnode_free(vol, dno);
         
+        if (dno->dir_index != NULL)
+            fsw_dir_index_free(dno->dir_index);
+        
         fsw_strfree(&dno->name);
         fsw_free(dno);
         
@@ -469,6 +1128,88 @@ fsw_status_t fsw_dnode_fill(struct fsw_dnode *dno)
     return dno->vol->fstype_table->dnode_fill(dno->vol, dno);
 }
 
+/**
+ * Fill a batch of dnodes from the same volume. This is equivalent to calling
+ * fsw_dnode_fill on each of the dnodes, but if the file system type can tell where
+ * a dnode's on-disk record lives (dnode_locate), the dnodes are filled in order of
+ * that block, and each block is held in the cache while the dnodes stored in it are
+ * filled. Directory listings thus read each inode table block only once, no matter
+ * in which order the entries appear in the directory.
+ *
+ * All dnodes are processed even if filling one of them fails; the first error is
+ * returned. Callers that need the result for each single dnode can call fsw_dnode_fill
+ * afterwards, which is cheap for dnodes that have already been filled.
+ */
+
+fsw_status_t fsw_dnode_fill_many(struct fsw_dnode **dnos, fsw_u32 count)
+{
+    fsw_status_t    status, result;
+    struct fsw_volume *vol;
+    fsw_u64         *bnos, phys_bno;
+    fsw_u32         *order;
+    fsw_u32         i, j, k;
+    void            *buffer;
+    
+    if (count == 0)
+        return FSW_SUCCESS;
+    vol = dnos[0]->vol;
+    result = FSW_SUCCESS;
+    
+    // without a way to locate dnodes, or on allocation failure, just fill them in turn
+    if (count < 2 || vol->fstype_table->dnode_locate == NULL ||
+        fsw_alloc((sizeof(fsw_u64) + sizeof(fsw_u32)) * count, &bnos) != FSW_SUCCESS) {
+        for (i = 0; i < count; i++) {
+            status = fsw_dnode_fill(dnos[i]);
+            if (status && result == FSW_SUCCESS)
+                result = status;
+        }
+        return result;
+    }
+    order = (fsw_u32 *)(bnos + count);
+    
+    // locate the dnodes and sort them by block (stable insertion sort, batches are small)
+    for (i = 0; i < count; i++) {
+        status = vol->fstype_table->dnode_locate(vol, dnos[i], &phys_bno);
+        if (status) {
+            if (result == FSW_SUCCESS)
+                result = status;
+            phys_bno = FSW_INVALID_BNO;
+        }
+        bnos[i] = phys_bno;
+        for (j = i; j > 0 && bnos[order[j - 1]] > phys_bno; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    
+    // fill the dnodes one block at a time
+    for (i = 0; i < count; i = j) {
+        phys_bno = bnos[order[i]];
+        for (j = i + 1; j < count && bnos[order[j]] == phys_bno; j++)
+            ;
+        
+        // hold the block while its dnodes are filled; dnodes that need no
+        //  block or failed to locate are simply filled on their own
+        buffer = NULL;
+        if (phys_bno != FSW_INVALID_BNO && j - i > 1) {
+            status = fsw_block_get(vol, phys_bno, 2, &buffer);
+            if (status)
+                buffer = NULL;
+        }
+        
+        for (k = i; k < j; k++) {
+            status = fsw_dnode_fill(dnos[order[k]]);
+            if (status && result == FSW_SUCCESS)
+                result = status;
+        }
+        
+        if (buffer != NULL)
+            fsw_block_release(vol, phys_bno, buffer);
+    }
+    
+    fsw_free(bnos);
+    return result;
+}
+
 /**
  * Get extended information about a dnode. This function can be called by the host
  * driver to get a full compliment of information about a dnode in addition to the
@@ -517,7 +1258,39 @@ fsw_status_t fsw_dnode_lookup(struct fsw_dnode *dno,
     if (dno->type != FSW_DNODE_TYPE_DIR)
         return FSW_UNSUPPORTED;
     
-    return dno->vol->fstype_table->dir_lookup(dno->vol, dno, lookup_name, child_dno_out);
+    return fsw_dnode_dir_lookup(dno, lookup_name, child_dno_out);
+}
+
+/**
+ * Look up a name in a directory through the directory entry cache. This internal
+ * function is used by fsw_dnode_lookup and fsw_dnode_lookup_path after they made
+ * sure that dno is a filled directory. Lookups that are not in the cache are passed
+ * on to the file system driver, and both found and not found results are cached.
+ */
+
+static fsw_status_t fsw_dnode_dir_lookup(struct fsw_dnode *dno,
+                                         struct fsw_string *lookup_name, struct fsw_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_dentry *de;
+    
+    de = fsw_dcache_lookup(vol, dno, lookup_name);
+    if (de != NULL) {
+        vol->dcache_hits++;
+        if (de->child == NULL)
+            return FSW_NOT_FOUND;
+        fsw_dnode_retain(de->child);
+        *child_dno_out = de->child;
+        return FSW_SUCCESS;
+    }
+    
+    status = vol->fstype_table->dir_lookup(vol, dno, lookup_name, child_dno_out);
+    if (status == FSW_SUCCESS)
+        fsw_dcache_insert(vol, dno, lookup_name, *child_dno_out);
+    else if (status == FSW_NOT_FOUND)
+        fsw_dcache_insert(vol, dno, lookup_name, NULL);
+    return status;
 }
 
 /**
@@ -609,7 +1382,7 @@ fsw_status_t fsw_dnode_lookup_path(struct fsw_dnode *dno,
                 
             } else {
                 // do an actual lookup
-                status = vol->fstype_table->dir_lookup(vol, dno, &lookup_name, &child_dno);
+                status = fsw_dnode_dir_lookup(dno, &lookup_name, &child_dno);
                 if (status)
                     goto errorexit;
             }
@@ -620,7 +1393,7 @@ fsw_status_t fsw_dnode_lookup_path(struct fsw_dnode *dno,
         dno = child_dno;   // is already retained
         child_dno = NULL;
         
-        FSW_MSG_DEBUG((FSW_MSGSTR("fsw_dnode_lookup_path: now at inode %d\n"), dno->dnode_id));
+        FSW_MSG_DEBUG((FSW_MSGSTR("fsw_dnode_lookup_path: now at inode %lld\n"), dno->dnode_id));
     }
     
     *child_dno_out = dno;
@@ -728,6 +1501,232 @@ fsw_status_t fsw_dnode_readlink_data(struct fsw_dnode *dno, struct fsw_string *l
     return status;
 }
 
+/**
+ * Look up a name in a directory through an in-memory hash index of the directory.
+ * This function can be called by the file system driver at the start of its
+ * dir_lookup function. The index is built with the driver's dir_read function the
+ * first time a directory is searched and is kept with the dnode, so that later
+ * lookups in the same directory don't need to scan it. A hit is re-read with a
+ * single dir_read call from the recorded directory position.
+ *
+ * The index assumes that dir_lookup finds exactly the entries returned by dir_read
+ * with an exact name comparison. On volumes marked case_insensitive, names are
+ * compared ignoring case instead; an entry with exactly the given name is preferred
+ * over the first entry that differs only in case. FSW_UNSUPPORTED is returned for
+ * directories smaller than FSW_DIR_INDEX_MIN_SIZE, for "." and "..", for names not in
+ * the host's string type and when the index can't be built. The driver must then scan
+ * the directory itself. Otherwise the result is final, including FSW_NOT_FOUND.
+ */
+
+fsw_status_t fsw_dnode_dir_index_lookup(struct fsw_dnode *dno, struct fsw_string *lookup_name,
+                                        struct fsw_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_dir_index *idx;
+    struct fsw_dir_index_entry *entry;
+    struct fsw_shandle shand;
+    struct fsw_string entry_name;
+    fsw_u32         i, hash, match;
+    
+    if (lookup_name->type != vol->host_string_type || lookup_name->size == 0 ||
+        fsw_streq_cstr(lookup_name, ".") || fsw_streq_cstr(lookup_name, ".."))
+        return FSW_UNSUPPORTED;
+    
+    if (dno->dir_index == NULL) {
+        if (dno->size < FSW_DIR_INDEX_MIN_SIZE)
+            return FSW_UNSUPPORTED;
+        status = fsw_dir_index_build(dno);
+        if (status)
+            return status;
+    }
+    idx = dno->dir_index;
+    
+    // find the first entry with that name
+    match = FSW_DIR_INDEX_END;
+    hash = idx->fold ? fsw_strhash_nocase(lookup_name, 0) : fsw_strhash(lookup_name, 0);
+    for (i = idx->buckets[hash & (idx->bucket_count - 1)]; i != FSW_DIR_INDEX_END; i = entry->next) {
+        entry = &idx->entries[i];
+        if (entry->hash != hash)
+            continue;
+        if (entry->name_size == (fsw_u32)lookup_name->size &&
+            fsw_memeq(idx->names + entry->name_offset, lookup_name->data, entry->name_size)) {
+            match = i;
+            break;
+        }
+        if (idx->fold && match == FSW_DIR_INDEX_END) {
+            // remember the first entry that differs only in case, keep looking for an exact match
+            entry_name.type = vol->host_string_type;
+            entry_name.size = entry->name_size;
+            entry_name.len = (entry_name.type == FSW_STRING_TYPE_UTF16) ? entry->name_size / 2 : entry->name_size;
+            entry_name.data = idx->names + entry->name_offset;
+            if (fsw_streq_nocase(&entry_name, lookup_name))
+                match = i;
+        }
+    }
+    if (match == FSW_DIR_INDEX_END)
+        return FSW_NOT_FOUND;
+    entry = &idx->entries[match];
+    
+    // let the file system driver read just that entry
+    status = fsw_shandle_open(dno, &shand);
+    if (status)
+        return status;
+    shand.pos = entry->pos;
+    status = vol->fstype_table->dir_read(vol, dno, &shand, child_dno_out);
+    fsw_shandle_close(&shand);
+    if (status == FSW_NOT_FOUND)
+        return FSW_UNSUPPORTED;
+    if (status)
+        return status;
+    if (idx->fold ? !fsw_streq_nocase(&(*child_dno_out)->name, lookup_name)
+                  : !fsw_streq(&(*child_dno_out)->name, lookup_name)) {
+        // the directory doesn't read back as indexed, fall back to a scan
+        fsw_dnode_release(*child_dno_out);
+        return FSW_UNSUPPORTED;
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Build the name index of a directory by reading all of its entries with the file
+ * system driver's dir_read function. The position before each dir_read call is
+ * recorded with the name of the returned entry. Allocation failures are reported
+ * as FSW_UNSUPPORTED, so the caller falls back to scanning the directory.
+ */
+
+static fsw_status_t fsw_dir_index_build(struct fsw_dnode *dno)
+{
+    fsw_status_t    status;
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_dir_index *idx;
+    struct fsw_dnode *child_dno;
+    struct fsw_shandle shand;
+    fsw_u32         i, pos, bucket;
+    
+    status = fsw_alloc_zero(sizeof(struct fsw_dir_index), (void **)&idx);
+    if (status)
+        return FSW_UNSUPPORTED;
+    idx->fold = vol->case_insensitive;
+    
+    status = fsw_shandle_open(dno, &shand);
+    if (status) {
+        fsw_free(idx);
+        return status;
+    }
+    while (1) {
+        pos = shand.pos;
+        status = vol->fstype_table->dir_read(vol, dno, &shand, &child_dno);
+        if (status == FSW_NOT_FOUND) {
+            status = FSW_SUCCESS;
+            break;
+        }
+        if (status)
+            break;
+        
+        status = fsw_dir_index_add(idx, pos, &child_dno->name);
+        fsw_dnode_release(child_dno);
+        if (status)
+            break;
+    }
+    fsw_shandle_close(&shand);
+    
+    // set up hash buckets with about two entries per bucket
+    if (status == FSW_SUCCESS) {
+        for (idx->bucket_count = 16; idx->bucket_count < (idx->entry_count >> 1); idx->bucket_count <<= 1)
+            ;
+        status = fsw_alloc(idx->bucket_count * sizeof(fsw_u32), &idx->buckets);
+        if (status)
+            status = FSW_UNSUPPORTED;
+    }
+    if (status) {
+        fsw_dir_index_free(idx);
+        return status;
+    }
+    for (i = 0; i < idx->bucket_count; i++)
+        idx->buckets[i] = FSW_DIR_INDEX_END;
+    // link in reverse order, so the first entry with a name comes first in its chain
+    for (i = idx->entry_count; i > 0; i--) {
+        bucket = idx->entries[i-1].hash & (idx->bucket_count - 1);
+        idx->entries[i-1].next = idx->buckets[bucket];
+        idx->buckets[bucket] = i - 1;
+    }
+    
+    dno->dir_index = idx;
+    fsw_dnode_account(dno, 0, sizeof(struct fsw_dir_index) +
+                      idx->entry_capacity * sizeof(struct fsw_dir_index_entry) +
+                      idx->names_capacity + idx->bucket_count * sizeof(fsw_u32));
+    return FSW_SUCCESS;
+}
+
+/**
+ * Append an entry to a directory index that is being built. The entries array and
+ * the name buffer are doubled in size as needed. Names in another string type than
+ * the host's can never match a lookup and are skipped.
+ */
+
+static fsw_status_t fsw_dir_index_add(struct fsw_dir_index *idx, fsw_u32 pos, struct fsw_string *name)
+{
+    fsw_status_t    status;
+    fsw_u32         new_capacity;
+    void            *new_buffer;
+    struct fsw_dir_index_entry *entry;
+    
+    if (name->type == FSW_STRING_TYPE_EMPTY || name->size == 0)
+        return FSW_SUCCESS;
+    
+    if (idx->entry_count >= idx->entry_capacity) {
+        new_capacity = idx->entry_capacity ? idx->entry_capacity * 2 : 64;
+        status = fsw_alloc(new_capacity * sizeof(struct fsw_dir_index_entry), &new_buffer);
+        if (status)
+            return FSW_UNSUPPORTED;
+        if (idx->entries != NULL) {
+            fsw_memcpy(new_buffer, idx->entries, idx->entry_count * sizeof(struct fsw_dir_index_entry));
+            fsw_free(idx->entries);
+        }
+        idx->entries = new_buffer;
+        idx->entry_capacity = new_capacity;
+    }
+    if (idx->names_size + name->size > idx->names_capacity) {
+        for (new_capacity = idx->names_capacity ? idx->names_capacity * 2 : 1024;
+             new_capacity < idx->names_size + name->size; new_capacity <<= 1)
+            ;
+        status = fsw_alloc(new_capacity, &new_buffer);
+        if (status)
+            return FSW_UNSUPPORTED;
+        if (idx->names != NULL) {
+            fsw_memcpy(new_buffer, idx->names, idx->names_size);
+            fsw_free(idx->names);
+        }
+        idx->names = new_buffer;
+        idx->names_capacity = new_capacity;
+    }
+    
+    entry = &idx->entries[idx->entry_count++];
+    entry->hash = idx->fold ? fsw_strhash_nocase(name, 0) : fsw_strhash(name, 0);
+    entry->pos = pos;
+    entry->name_offset = idx->names_size;
+    entry->name_size = name->size;
+    fsw_memcpy(idx->names + idx->names_size, name->data, name->size);
+    idx->names_size += name->size;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Free a directory index. Called internally when its dnode is freed.
+ */
+
+static void fsw_dir_index_free(struct fsw_dir_index *idx)
+{
+    if (idx->entries != NULL)
+        fsw_free(idx->entries);
+    if (idx->names != NULL)
+        fsw_free(idx->names);
+    if (idx->buckets != NULL)
+        fsw_free(idx->buckets);
+    fsw_free(idx);
+}
+
 /**
  * Resolve a symbolic link. This function can be called by the host driver to make
  * sure the a dnode is fully resolved instead of pointing at a symlink. If the dnode
@@ -815,6 +1814,11 @@ fsw_status_t fsw_shandle_open(struct fsw_dnode *dno, struct fsw_shandle *shand)
     shand->dnode = dno;
     shand->pos = 0;
     shand->extent.type = FSW_EXTENT_TYPE_INVALID;
+    shand->fs_data = NULL;
+    shand->ra_next_pos = 0;
+    shand->ra_buffer = NULL;
+    shand->ra_capacity = 0;
+    shand->ra_count = 0;
     
     return FSW_SUCCESS;
 }
@@ -822,20 +1826,32 @@ fsw_status_t fsw_shandle_open(struct fsw_dnode *dno, struct fsw_shandle *shand)
 /**
  * Close a shandle after accessing the dnode's data. This function is called by the host
  * driver or core functions when they are finished with accessing a file's data. It
- * releases the dnode reference and frees any buffers associated with the shandle itself.
+ * lets the file system driver release its own data attached to the shandle, releases
+ * the dnode reference and frees any buffers associated with the shandle itself.
  * The dnode is only released if this was the last reference using it.
  */
 
 void fsw_shandle_close(struct fsw_shandle *shand)
 {
+    struct fsw_volume *vol = shand->dnode->vol;
+    
+    if (shand->fs_data != NULL && vol->fstype_table->shandle_close != NULL)
+        vol->fstype_table->shandle_close(vol, shand);
     if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER)
         fsw_free(shand->extent.buffer);
+    if (shand->ra_buffer != NULL)
+        fsw_free(shand->ra_buffer);
     fsw_dnode_release(shand->dnode);
 }
 
 /**
  * Read data from a shandle (storage handle for a dnode). This function is called by the
- * host driver or internally when data is read from a file. TODO: more
+ * host driver or internally when data is read from a file.
+ *
+ * Whole physical blocks of file data are read straight into the caller's buffer. When a
+ * file is read sequentially in pieces smaller than the read-ahead window, the blocks are
+ * instead read in batches into a per-shandle read-ahead buffer (see fsw_shandle_readahead)
+ * and copied from there. All other data goes through the block cache.
  */
 
 fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_inout, void *buffer_in)
@@ -844,9 +1860,10 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     struct fsw_dnode *dno = shand->dnode;
     struct fsw_volume *vol = dno->vol;
     fsw_u8          *buffer, *block_buffer;
-    fsw_u32         buflen, copylen, pos;
-    fsw_u32         log_bno, pos_in_extent, phys_bno, pos_in_physblock;
-    fsw_u32         cache_level;
+    fsw_u32         buflen, copylen;
+    fsw_u64         pos, pos_in_extent, extent_left, phys_bno;
+    fsw_u32         log_bno, pos_in_physblock;
+    fsw_u32         cache_level, direct_count, ra_window, ra_index;
     
     if (shand->pos >= dno->size) {   // already at EOF
         *buffer_size_inout = 0;
@@ -856,15 +1873,19 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     // initialize vars
     buffer = buffer_in;
     buflen = *buffer_size_inout;
-    pos = (fsw_u32)shand->pos;
+    pos = shand->pos;
     cache_level = (dno->type != FSW_DNODE_TYPE_FILE) ? 1 : 0;
+    // use read-ahead for file data if this read continues where the last one ended
+    ra_window = 0;
+    if (cache_level == 0 && shand->pos == shand->ra_next_pos)
+        ra_window = vol->readahead_size / vol->phys_blocksize;
     // restrict read to file size
     if (buflen > dno->size - pos)
         buflen = (fsw_u32)(dno->size - pos);
     
     while (buflen > 0) {
         // get extent for the current logical block
-        log_bno = pos / vol->log_blocksize;
+        log_bno = FSW_POS_DIV(pos, vol->log_blocksize);
         if (shand->extent.type == FSW_EXTENT_TYPE_INVALID ||
             log_bno < shand->extent.log_start ||
             log_bno >= shand->extent.log_start + shand->extent.log_count) {
@@ -881,36 +1902,83 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
             }
         }
         
-        pos_in_extent = pos - shand->extent.log_start * vol->log_blocksize;
+        pos_in_extent = pos - (fsw_u64)shand->extent.log_start * vol->log_blocksize;
+        extent_left = (fsw_u64)shand->extent.log_count * vol->log_blocksize - pos_in_extent;
         
         // dispatch by extent type
         if (shand->extent.type == FSW_EXTENT_TYPE_PHYSBLOCK) {
             // convert to physical block number and offset
-            phys_bno = shand->extent.phys_start + pos_in_extent / vol->phys_blocksize;
-            pos_in_physblock = pos_in_extent & (vol->phys_blocksize - 1);
-            copylen = vol->phys_blocksize - pos_in_physblock;
-            if (copylen > buflen)
-                copylen = buflen;
+            phys_bno = shand->extent.phys_start + FSW_POS_DIV(pos_in_extent, vol->phys_blocksize);
+            pos_in_physblock = (fsw_u32)pos_in_extent & (vol->phys_blocksize - 1);
             
-            // get one physical block
-            status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
-            if (status)
-                return status;
+            // check the read-ahead buffer first
+            ra_index = (fsw_u32)(phys_bno - shand->ra_phys_start);
+            if (phys_bno >= shand->ra_phys_start && ra_index < shand->ra_count) {
+                copylen = (shand->ra_count - ra_index) * vol->phys_blocksize - pos_in_physblock;
+                if (copylen > extent_left)
+                    copylen = (fsw_u32)extent_left;
+                if (copylen > buflen)
+                    copylen = buflen;
+                fsw_memcpy(buffer, (fsw_u8 *)shand->ra_buffer + ra_index * vol->phys_blocksize + pos_in_physblock,
+                           copylen);
+                vol->readahead_hits += (pos_in_physblock + copylen + vol->phys_blocksize - 1) / vol->phys_blocksize;
+                
+                buffer += copylen;
+                buflen -= copylen;
+                pos    += copylen;
+                continue;
+            }
             
-            // copy data from it
-            fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
-            fsw_block_release(vol, phys_bno, block_buffer);
+            // count the whole physical blocks that the extent and the buffer have left;
+            //  only file data bypasses the cache, other data is likely to be read again
+            direct_count = 0;
+            if (pos_in_physblock == 0 && cache_level == 0) {
+                copylen = buflen;
+                if (copylen > extent_left)
+                    copylen = (fsw_u32)extent_left;
+                direct_count = copylen / vol->phys_blocksize;
+            }
+            
+            if (cache_level == 0 && ra_window > 1 && direct_count < ra_window) {
+                // sequential access in small pieces, fill the read-ahead buffer and retry
+                status = fsw_shandle_readahead(shand, phys_bno, pos_in_extent);
+                if (status)
+                    return status;
+                continue;
+                
+            } else if (direct_count > 0) {
+                // read whole blocks straight into the caller's buffer
+                copylen = direct_count * vol->phys_blocksize;
+                status = fsw_block_read_direct(vol, phys_bno, direct_count, buffer);
+                if (status)
+                    return status;
+                
+            } else {
+                // partial block at the head or tail of the request
+                copylen = vol->phys_blocksize - pos_in_physblock;
+                if (copylen > buflen)
+                    copylen = buflen;
+                
+                // get one physical block
+                status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
+                if (status)
+                    return status;
+                
+                // copy data from it
+                fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
+                fsw_block_release(vol, phys_bno, block_buffer);
+            }
             
         } else if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER) {
-            copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
-            if (copylen > buflen)
-                copylen = buflen;
+            copylen = buflen;
+            if (copylen > extent_left)
+                copylen = (fsw_u32)extent_left;
             fsw_memcpy(buffer, (fsw_u8 *)shand->extent.buffer + pos_in_extent, copylen);
             
         } else {   // _SPARSE or _INVALID
-            copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
-            if (copylen > buflen)
-                copylen = buflen;
+            copylen = buflen;
+            if (copylen > extent_left)
+                copylen = (fsw_u32)extent_left;
             fsw_memzero(buffer, copylen);
             
         }
@@ -922,6 +1990,84 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     
     *buffer_size_inout = (fsw_u32)(pos - shand->pos);
     shand->pos = pos;
+    shand->ra_next_pos = pos;
+    
+    return FSW_SUCCESS;
+}
+
+/**
+ * Fill the read-ahead buffer of a shandle, starting at the given physical block. This
+ * is called by fsw_shandle_read when file data is read sequentially. The run of blocks is
+ * extended beyond the current extent by asking the file system driver for the following
+ * extents, as long as they continue on disk without a gap. The whole run is then read with
+ * a single host call. The run is limited by the volume's read-ahead window and by the end
+ * of the file.
+ *
+ * The shandle's current extent is left untouched.
+ */
+
+static fsw_status_t fsw_shandle_readahead(struct fsw_shandle *shand, fsw_u64 phys_bno, fsw_u64 pos_in_extent)
+{
+    fsw_status_t    status;
+    struct fsw_dnode *dno = shand->dnode;
+    struct fsw_volume *vol = dno->vol;
+    struct fsw_extent extent;
+    fsw_u32         window, count, next_log_bno;
+    fsw_u64         file_pos, file_bcnt, extent_bcnt;
+    
+    // (re)allocate the buffer to match the current window
+    window = vol->readahead_size / vol->phys_blocksize;
+    shand->ra_count = 0;
+    if (shand->ra_capacity != window) {
+        if (shand->ra_buffer != NULL)
+            fsw_free(shand->ra_buffer);
+        shand->ra_buffer = NULL;
+        shand->ra_capacity = 0;
+        status = fsw_alloc(window * vol->phys_blocksize, &shand->ra_buffer);
+        if (status)
+            return status;
+        shand->ra_capacity = window;
+    }
+    
+    // don't read beyond the end of the file
+    pos_in_extent -= (fsw_u32)pos_in_extent & (vol->phys_blocksize - 1);
+    file_pos = (fsw_u64)shand->extent.log_start * vol->log_blocksize + pos_in_extent;
+    file_bcnt = FSW_U64_DIV(dno->size - file_pos + vol->phys_blocksize - 1, vol->phys_blocksize);
+    if (window > file_bcnt)
+        window = (fsw_u32)file_bcnt;
+    
+    // blocks left in the current extent
+    extent_bcnt = FSW_U64_DIV((fsw_u64)shand->extent.log_count * vol->log_blocksize - pos_in_extent +
+                              vol->phys_blocksize - 1, vol->phys_blocksize);
+    count = (extent_bcnt > window) ? window : (fsw_u32)extent_bcnt;
+    
+    // add following extents while they are contiguous on disk
+    next_log_bno = shand->extent.log_start + shand->extent.log_count;
+    while (count < window && (fsw_u64)next_log_bno * vol->log_blocksize < dno->size) {
+        extent.log_start = next_log_bno;
+        status = vol->fstype_table->get_extent(vol, dno, &extent);
+        if (status)
+            break;      // not fatal here, the error is reported when the data is actually read
+        if (extent.type == FSW_EXTENT_TYPE_BUFFER)
+            fsw_free(extent.buffer);
+        if (extent.type != FSW_EXTENT_TYPE_PHYSBLOCK || extent.phys_start != phys_bno + count)
+            break;
+        
+        count += extent.log_count * (vol->log_blocksize / vol->phys_blocksize);
+        next_log_bno += extent.log_count;
+    }
+    if (count > window)
+        count = window;
+    
+    // read the whole run at once
+    status = fsw_block_read_direct(vol, phys_bno, count, shand->ra_buffer);
+    if (status)
+        return status;
+    shand->ra_phys_start = phys_bno;
+    shand->ra_count = count;
+    
+    vol->readahead_fills++;
+    vol->readahead_blocks += count;
     
     return FSW_SUCCESS;
 }
@@ -52,7 +52,21 @@
 #define FSW_FSTYPE_TABLE_NAME(t) FSW_CONCAT3(fsw_,t,_table)
 
 /** Indicates that the block cache entry is empty. */
-#define FSW_INVALID_BNO (~0UL)
+#define FSW_INVALID_BNO (~(fsw_u64)0)
+/** Highest cache level a block can be tagged with in fsw_block_get. */
+#define FSW_MAX_CACHE_LEVEL (5)
+/** Memory budget in bytes for a volume's block cache if the host doesn't specify one. */
+#define FSW_BCACHE_DEFAULT_BUDGET (1024*1024)
+/** Minimum number of blocks the block cache may keep, regardless of the memory budget. */
+#define FSW_BCACHE_MIN_SIZE (16)
+/** Read-ahead window in bytes for sequential reads of file data, set when mounting a volume. */
+#define FSW_READAHEAD_DEFAULT_SIZE (64*1024)
+/** Fraction (1/n) of a volume's cache budget that is set aside for the directory entry cache. */
+#define FSW_DCACHE_BUDGET_SHARE (8)
+/** Directories smaller than this many bytes are scanned by fsw_dnode_dir_index_lookup instead of indexed. */
+#define FSW_DIR_INDEX_MIN_SIZE (4096)
+/** Number of directory entries a host reads ahead and fills as one batch when enumerating a directory. */
+#define FSW_DNODE_FILL_BATCH (32)
 
 
 //
@@ -209,8 +223,43 @@ struct fsw_fstype_table;
 struct fsw_blockcache {
     fsw_u32     refcount;           //!< Reference count
     fsw_u32     cache_level;        //!< Level of importance of this block
-    fsw_u32     phys_bno;           //!< Physical block number
+    fsw_u64     phys_bno;           //!< Physical block number
     void        *data;              //!< Block data buffer
+    
+    struct fsw_blockcache *hash_next;   //!< Next entry in the same hash bucket (or in the free list)
+    struct fsw_blockcache *lru_next;    //!< LRU list of unreferenced entries: next (more recently used) entry
+    struct fsw_blockcache *lru_prev;    //!< LRU list of unreferenced entries: previous (less recently used) entry
+};
+
+struct fsw_dentry {
+    struct fsw_dnode *parent;       //!< Directory that was searched, retained by the entry
+    struct fsw_string name;         //!< Name that was looked up, in the host's string type
+    struct fsw_dnode *child;        //!< Dnode that was found (retained), or NULL for a negative entry
+    fsw_u32     size;               //!< Memory charged against the directory entry cache budget
+    
+    struct fsw_dentry *hash_next;   //!< Next entry in the same hash bucket
+    struct fsw_dentry *lru_next;    //!< LRU list: next (more recently used) entry
+    struct fsw_dentry *lru_prev;    //!< LRU list: previous (less recently used) entry
+};
+
+struct fsw_dir_index_entry {
+    fsw_u32     hash;               //!< Hash value of the name
+    fsw_u32     pos;                //!< Directory position from which dir_read returns this entry
+    fsw_u32     name_offset;        //!< Offset of the name in the index's name buffer
+    fsw_u32     name_size;          //!< Size of the name in bytes
+    fsw_u32     next;               //!< Next entry in the same hash bucket, or FSW_DIR_INDEX_END
+};
+
+struct fsw_dir_index {
+    struct fsw_dir_index_entry *entries;    //!< Array of all entries, in directory order
+    fsw_u32     entry_count;        //!< Number of entries
+    fsw_u32     entry_capacity;     //!< Allocated size of the entries array
+    fsw_u8      *names;             //!< Names of all entries in the host's string type
+    fsw_u32     names_size;         //!< Number of bytes used in the name buffer
+    fsw_u32     names_capacity;     //!< Allocated size of the name buffer
+    fsw_u32     *buckets;           //!< First entry of each hash bucket, or FSW_DIR_INDEX_END
+    fsw_u32     bucket_count;       //!< Number of hash buckets (power of 2)
+    int         fold;               //!< Hash values ignore case (the volume is case_insensitive)
 };
 
 /**
@@ -223,11 +272,35 @@ struct fsw_volume {
     
     struct DNODESTRUCTNAME *root;   //!< Root directory dnode
     struct fsw_string label;        //!< Volume label
+    int         case_insensitive;   //!< Name lookups ignore case, exact matches are preferred; set by the file system driver
     
     struct fsw_dnode *dnode_head;   //!< List of all dnodes allocated for this volume
+    struct fsw_dnode **dnode_hash;  //!< Open-addressing hash table of all dnodes, indexed by dnode_id
+    fsw_u32     dnode_hash_size;    //!< Number of slots in the dnode hash table (power of 2)
+    fsw_u32     dnode_count;        //!< Number of dnodes in the hash table
+    
+    struct fsw_blockcache **bcache_hash;    //!< Hash table of cached blocks, indexed by physical block number
+    fsw_u32     bcache_hash_size;   //!< Number of buckets in the hash table (power of 2)
+    struct fsw_blockcache *bcache_free;     //!< List of allocated but unused block cache entries
+    struct fsw_blockcache *bcache_lru_head[FSW_MAX_CACHE_LEVEL+1];  //!< Unreferenced entries per cache level, least recently used first
+    struct fsw_blockcache *bcache_lru_tail[FSW_MAX_CACHE_LEVEL+1];  //!< Unreferenced entries per cache level, most recently used last
+    fsw_u32     bcache_count;       //!< Number of allocated block cache entries
+    fsw_u32     bcache_size;        //!< Number of entries the block cache may keep within its budget
+    fsw_u32     bcache_budget;      //!< Memory budget for the block and directory entry caches in bytes
     
-    struct fsw_blockcache *bcache;  //!< Array of block cache entries
-    fsw_u32     bcache_size;        //!< Number of entries in the block cache array
+    struct fsw_dentry **dcache_hash;    //!< Hash table of cached directory lookups, indexed by parent dnode and name
+    fsw_u32     dcache_hash_size;   //!< Number of buckets in the hash table (power of 2)
+    struct fsw_dentry *dcache_lru_head; //!< Cached directory lookups, least recently used first
+    struct fsw_dentry *dcache_lru_tail; //!< Cached directory lookups, most recently used last
+    fsw_u32     dcache_count;       //!< Number of cached directory lookups
+    fsw_u32     dcache_used;        //!< Memory charged by cached directory lookups in bytes
+    fsw_u32     dcache_budget;      //!< Memory budget for cached directory lookups in bytes
+    fsw_u32     dcache_hits;        //!< Statistics: Number of directory lookups answered from the cache
+    
+    fsw_u32     readahead_size;     //!< Read-ahead window for sequential file reads in bytes, 0 disables read-ahead
+    fsw_u32     readahead_fills;    //!< Statistics: Number of host reads issued to fill read-ahead buffers
+    fsw_u32     readahead_blocks;   //!< Statistics: Number of blocks read into read-ahead buffers
+    fsw_u32     readahead_hits;     //!< Statistics: Number of blocks copied from read-ahead buffers, per read that touches them
     
     void        *host_data;         //!< Hook for a host-specific data structure
     struct fsw_host_table *host_table;      //!< Dispatch table for host-specific functions
@@ -246,10 +319,14 @@ struct fsw_dnode {
     struct DNODESTRUCTNAME *parent; //!< Parent directory dnode
     struct fsw_string name;         //!< Name of this item in the parent directory
     
-    fsw_u32     dnode_id;           //!< Unique id number (usually the inode number)
+    fsw_u64     dnode_id;           //!< Unique id number (usually the inode number)
     int         type;               //!< Type of the dnode - file, dir, symlink, special
     fsw_u64     size;               //!< Data size in bytes
     
+    struct fsw_dir_index *dir_index;    //!< Name index built by fsw_dnode_dir_index_lookup, may be NULL
+    fsw_u32     owned_size;         //!< Memory held through the dnode (index, block map, raw inode) in bytes
+    fsw_u32     dcache_refs;        //!< Number of references held by the directory entry cache
+    
     struct fsw_dnode *next;         //!< Doubly-linked list of all dnodes: previous dnode
     struct fsw_dnode *prev;         //!< Doubly-linked list of all dnodes: next dnode
 };
@@ -274,7 +351,7 @@ struct fsw_extent {
     int         type;               //!< Type of extent specification
     fsw_u32     log_start;          //!< Starting logical block number
     fsw_u32     log_count;          //!< Logical block count
-    fsw_u32     phys_start;         //!< Starting physical block number (for FSW_EXTENT_TYPE_PHYSBLOCK only)
+    fsw_u64     phys_start;         //!< Starting physical block number (for FSW_EXTENT_TYPE_PHYSBLOCK only)
     void        *buffer;            //!< Allocated buffer pointer (for FSW_EXTENT_TYPE_BUFFER only)
 };
 
@@ -299,6 +376,13 @@ struct fsw_shandle {
     
     fsw_u64     pos;                //!< Current file pointer in bytes
     struct fsw_extent extent;       //!< Current extent
+    void        *fs_data;           //!< Hook for file system specific data, released by the fstype's shandle_close
+    
+    fsw_u64     ra_next_pos;        //!< Read-ahead: File position where the last read ended
+    void        *ra_buffer;         //!< Read-ahead: Buffer for consecutive physical blocks, or NULL
+    fsw_u32     ra_capacity;        //!< Read-ahead: Size of ra_buffer in physical blocks
+    fsw_u64     ra_phys_start;      //!< Read-ahead: First physical block held in ra_buffer
+    fsw_u32     ra_count;           //!< Read-ahead: Number of valid physical blocks in ra_buffer
 };
 
 /**
@@ -310,6 +394,17 @@ struct fsw_volume_stat {
     fsw_u64     free_bytes;         //!< Bytes still available for storing file data
 };
 
+/**
+ * Core: Used in gathering read-ahead statistics of a volume.
+ */
+
+struct fsw_readahead_stat {
+    fsw_u32     window_bytes;       //!< Read-ahead window in bytes as set by fsw_set_readahead
+    fsw_u32     fills;              //!< Number of host reads issued to fill read-ahead buffers
+    fsw_u32     blocks_read;        //!< Number of physical blocks read into read-ahead buffers
+    fsw_u32     blocks_hit;         //!< Number of physical blocks copied from read-ahead buffers, per read that touches them
+};
+
 /**
  * Core: Used in gathering detailed information on a dnode.
  */
@@ -337,11 +432,16 @@ enum {
 struct fsw_host_table
 {
     int         native_string_type; //!< String type used by the host environment
+    fsw_u32     bcache_budget;      //!< Block and directory entry cache memory budget per volume in bytes, 0 for the default
     
     void         (*change_blocksize)(struct fsw_volume *vol,
                                      fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                      fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-    fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+    fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+    fsw_status_t (*read_blocks)(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);  //!< Optional, may be NULL
+    fsw_status_t (*block_get)(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level,
+                              void **buffer_out);   //!< Optional, may be NULL; FSW_UNSUPPORTED falls back to the block cache
+    void         (*block_release)(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);   //!< Optional, may be NULL
 };
 
 /**
@@ -371,6 +471,10 @@ struct fsw_fstype_table
                              struct fsw_shandle *shand, struct DNODESTRUCTNAME **child_dno);
     fsw_status_t (*readlink)(struct VOLSTRUCTNAME *vol, struct DNODESTRUCTNAME *dno,
                              struct fsw_string *link_target);
+    
+    void         (*shandle_close)(struct VOLSTRUCTNAME *vol, struct fsw_shandle *shand);  //!< Optional, may be NULL
+    fsw_status_t (*dnode_locate)(struct VOLSTRUCTNAME *vol, struct DNODESTRUCTNAME *dno,
+                                 fsw_u64 *phys_bno);    //!< Optional, may be NULL
 };
 
 
@@ -387,8 +491,11 @@ void         fsw_unmount(struct fsw_volume *vol);
 fsw_status_t fsw_volume_stat(struct fsw_volume *vol, struct fsw_volume_stat *sb);
 
 void         fsw_set_blocksize(struct VOLSTRUCTNAME *vol, fsw_u32 phys_blocksize, fsw_u32 log_blocksize);
-fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out);
-void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer);
+void         fsw_set_bcache_budget(struct VOLSTRUCTNAME *vol, fsw_u32 budget);
+void         fsw_set_readahead(struct VOLSTRUCTNAME *vol, fsw_u32 readahead_size);
+void         fsw_get_readahead_stat(struct VOLSTRUCTNAME *vol, struct fsw_readahead_stat *sb);
+fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer);
 
 /*@}*/
 
@@ -398,13 +505,15 @@ void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void
  */
 /*@{*/
 
-fsw_status_t fsw_dnode_create_root(struct VOLSTRUCTNAME *vol, fsw_u32 dnode_id, struct DNODESTRUCTNAME **dno_out);
-fsw_status_t fsw_dnode_create(struct DNODESTRUCTNAME *parent_dno, fsw_u32 dnode_id, int type,
+fsw_status_t fsw_dnode_create_root(struct VOLSTRUCTNAME *vol, fsw_u64 dnode_id, struct DNODESTRUCTNAME **dno_out);
+fsw_status_t fsw_dnode_create(struct DNODESTRUCTNAME *parent_dno, fsw_u64 dnode_id, int type,
                               struct fsw_string *name, struct DNODESTRUCTNAME **dno_out);
 void         fsw_dnode_retain(struct fsw_dnode *dno);
 void         fsw_dnode_release(struct fsw_dnode *dno);
+void         fsw_dnode_account(struct DNODESTRUCTNAME *dno, fsw_u32 old_size, fsw_u32 new_size);
 
 fsw_status_t fsw_dnode_fill(struct fsw_dnode *dno);
+fsw_status_t fsw_dnode_fill_many(struct fsw_dnode **dnos, fsw_u32 count);
 fsw_status_t fsw_dnode_stat(struct fsw_dnode *dno, struct fsw_dnode_stat *sb);
 
 fsw_status_t fsw_dnode_lookup(struct fsw_dnode *dno,
@@ -415,6 +524,8 @@ fsw_status_t fsw_dnode_lookup_path(struct fsw_dnode *dno,
 fsw_status_t fsw_dnode_dir_read(struct fsw_shandle *shand, struct fsw_dnode **child_dno_out);
 fsw_status_t fsw_dnode_readlink(struct fsw_dnode *dno, struct fsw_string *link_target);
 fsw_status_t fsw_dnode_readlink_data(struct DNODESTRUCTNAME *dno, struct fsw_string *link_target);
+fsw_status_t fsw_dnode_dir_index_lookup(struct DNODESTRUCTNAME *dno, struct fsw_string *lookup_name,
+                                        struct DNODESTRUCTNAME **child_dno_out);
 fsw_status_t fsw_dnode_resolve(struct fsw_dnode *dno, struct fsw_dnode **target_dno_out);
 
 /*@}*/
@@ -451,6 +562,8 @@ fsw_status_t fsw_memdup(void **dest_out, void *src, int len);
 int          fsw_strlen(struct fsw_string *s);
 int          fsw_streq(struct fsw_string *s1, struct fsw_string *s2);
 int          fsw_streq_cstr(struct fsw_string *s1, const char *s2);
+int          fsw_streq_nocase(struct fsw_string *s1, struct fsw_string *s2);
+fsw_u32      fsw_strhash_nocase(struct fsw_string *s, fsw_u32 seed);
 fsw_status_t fsw_strdup_coerce(struct fsw_string *dest, int type, struct fsw_string *src);
 void         fsw_strsplit(struct fsw_string *lookup_name, struct fsw_string *buffer, char separator);
 
@@ -45,6 +45,11 @@
 #define FSTYPE ext2
 #endif
 
+#ifndef FSW_EFI_BCACHE_BUDGET
+/** The block cache memory budget per volume in bytes. */
+#define FSW_EFI_BCACHE_BUDGET FSW_BCACHE_DEFAULT_BUDGET
+#endif
+
 /** Helper macro for stringification. */
 #define FSW_EFI_STRINGIFY(x) L#x
 /** Expands to the EFI driver name given the file system type name. */
@@ -75,7 +80,14 @@ EFI_STATUS EFIAPI fsw_efi_ComponentName_GetControllerName(IN  EFI_COMPONENT_NAME
 void fsw_efi_change_blocksize(struct fsw_volume *vol,
                               fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                               fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_status_t fsw_efi_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+
+VOID    fsw_efi_async_init(IN FSW_VOLUME_DATA *Volume);
+VOID    fsw_efi_async_shutdown(IN FSW_VOLUME_DATA *Volume);
+BOOLEAN fsw_efi_async_complete(IN FSW_EFI_ASYNC_REQUEST *Request, IN BOOLEAN Wait);
+VOID    fsw_efi_async_trim(IN FSW_EFI_ASYNC_REQUEST *Request);
+VOID    fsw_efi_async_readahead(IN struct fsw_volume *vol, IN fsw_u64 phys_bno, IN fsw_u32 count);
 
 EFI_STATUS fsw_efi_map_status(fsw_status_t fsw_status, FSW_VOLUME_DATA *Volume);
 
@@ -102,6 +114,8 @@ EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
                             OUT VOID *Buffer);
 EFI_STATUS fsw_efi_dir_setpos(IN FSW_FILE_DATA *File,
                               IN UINT64 Position);
+EFI_STATUS fsw_efi_dir_fill_batch(IN FSW_FILE_DATA *File);
+VOID       fsw_efi_dir_drop_batch(IN FSW_FILE_DATA *File);
 
 EFI_STATUS fsw_efi_dnode_getinfo(IN FSW_FILE_DATA *File,
                                  IN EFI_GUID *InformationType,
@@ -112,6 +126,9 @@ EFI_STATUS fsw_efi_dnode_fill_FileInfo(IN FSW_VOLUME_DATA *Volume,
                                        IN OUT UINTN *BufferSize,
                                        OUT VOID *Buffer);
 
+/** GUID of the optional Disk I/O 2 protocol. */
+static EFI_GUID fsw_efi_DiskIo2Protocol = EFI_DISK_IO2_PROTOCOL_GUID;
+
 /**
  * Interface structure for the EFI Driver Binding protocol.
  */
@@ -141,9 +158,13 @@ EFI_COMPONENT_NAME_PROTOCOL fsw_efi_ComponentName_table = {
 
 struct fsw_host_table   fsw_efi_host_table = {
     FSW_STRING_TYPE_UTF16,
+    FSW_EFI_BCACHE_BUDGET,
     
     fsw_efi_change_blocksize,
-    fsw_efi_read_block
+    fsw_efi_read_block,
+    fsw_efi_read_blocks,
+    NULL,
+    NULL
 };
 
 extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(FSTYPE);
@@ -239,6 +260,8 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Supported(IN EFI_DRIVER_BINDING_PROTOCOL
  * This function allocates memory for a per-volume structure, opens the
  * required protocols (just Disk I/O in our case, Block I/O is only looked
  * at to get the MediaId field), and lets the FSW core mount the file system.
+ * Disk I/O 2 is picked up as well when the firmware provides it; it is used
+ * to keep read-ahead requests in flight.
  * If successful, an EFI Simple File System protocol is exported on the
  * device handle.
  */
@@ -287,6 +310,18 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Start(IN EFI_DRIVER_BINDING_PROTOCOL  *T
     Volume->MediaId         = BlockIo->Media->MediaId;
     Volume->LastIOStatus    = EFI_SUCCESS;
     
+    // Disk I/O 2 is optional, without it all reads are synchronous
+    Status = BS->OpenProtocol(ControllerHandle,
+                              &fsw_efi_DiskIo2Protocol,
+                              (VOID **) &Volume->DiskIo2,
+                              This->DriverBindingHandle,
+                              ControllerHandle,
+                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+    if (EFI_ERROR(Status))
+        Volume->DiskIo2 = NULL;
+    else
+        fsw_efi_async_init(Volume);
+    
     // mount the filesystem
     Status = fsw_efi_map_status(fsw_mount(Volume, &fsw_efi_host_table,
                                           &FSW_FSTYPE_TABLE_NAME(FSTYPE), &Volume->vol),
@@ -307,6 +342,7 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Start(IN EFI_DRIVER_BINDING_PROTOCOL  *T
     if (EFI_ERROR(Status)) {
         if (Volume->vol != NULL)
             fsw_unmount(Volume->vol);
+        fsw_efi_async_shutdown(Volume);
         FreePool(Volume);
         
         BS->CloseProtocol(ControllerHandle,
@@ -369,6 +405,7 @@ EFI_STATUS EFIAPI fsw_efi_DriverBinding_Stop(IN  EFI_DRIVER_BINDING_PROTOCOL  *T
     // release private data structure
     if (Volume->vol != NULL)
         fsw_unmount(Volume->vol);
+    fsw_efi_async_shutdown(Volume);
     FreePool(Volume);
     
     // close the consumed protocols
@@ -431,12 +468,12 @@ void fsw_efi_change_blocksize(struct fsw_volume *vol,
  * to read a block of data from the device. The buffer is allocated by the core code.
  */
 
-fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer)
+fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
 {
     EFI_STATUS          Status;
     FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)vol->host_data;
     
-    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_efi_read_block: %d  (%d)\n"), phys_bno, vol->phys_blocksize));
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_efi_read_block: %lld  (%d)\n"), phys_bno, vol->phys_blocksize));
     
     // read from disk
     Status = Volume->DiskIo->ReadDisk(Volume->DiskIo, Volume->MediaId,
@@ -449,6 +486,227 @@ fsw_status_t fsw_efi_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *
     return FSW_SUCCESS;
 }
 
+/**
+ * FSW interface function to read a run of consecutive data blocks. This function is
+ * called by the FSW core to read file data directly into the caller's buffer. The whole
+ * run is transferred with a single Disk I/O call.
+ *
+ * When Disk I/O 2 is available and the run continues the previous one, the following
+ * runs of the same length, up to FSW_EFI_ASYNC_MAX_SIZE bytes each, are queued as
+ * read-ahead requests, so the device keeps working while the core consumes this run.
+ * A later call that starts at a queued run takes its data from there and from the
+ * queued runs that directly follow it, and only reads what they did not cover.
+ */
+
+fsw_status_t fsw_efi_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer)
+{
+    EFI_STATUS          Status;
+    FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)vol->host_data;
+    FSW_EFI_ASYNC_REQUEST *Request;
+    fsw_u32             done = 0, taken;
+    UINTN               i;
+    BOOLEAN             sequential = FALSE;
+    
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_efi_read_blocks: %lld+%d  (%d)\n"), phys_bno, count, vol->phys_blocksize));
+    
+    if (Volume->DiskIo2 != NULL) {
+        sequential = (phys_bno == Volume->AsyncNextBno);
+        
+        // take the leading blocks from the read-ahead requests that follow each other from here
+        while (done < count) {
+            for (i = 0; i < FSW_EFI_ASYNC_DEPTH; i++) {
+                Request = &Volume->Async[i];
+                if (Request->Pending && Request->PhysBno == phys_bno + done)
+                    break;
+            }
+            if (i == FSW_EFI_ASYNC_DEPTH)
+                break;
+            
+            fsw_efi_async_complete(Request, TRUE);
+            Request->Pending = FALSE;
+            taken = 0;
+            if (!EFI_ERROR(Request->Token.TransactionStatus)) {
+                taken = (Request->Count < count - done) ? Request->Count : count - done;
+                CopyMem((fsw_u8 *)buffer + (UINTN)done * vol->phys_blocksize, Request->Buffer,
+                        (UINTN)taken * vol->phys_blocksize);
+                done += taken;
+            }
+            fsw_efi_async_trim(Request);
+            if (taken == 0)
+                break;
+        }
+    }
+    
+    // read the rest from disk
+    if (done < count) {
+        Status = Volume->DiskIo->ReadDisk(Volume->DiskIo, Volume->MediaId,
+                                          (UINT64)(phys_bno + done) * vol->phys_blocksize,
+                                          (UINTN)(count - done) * vol->phys_blocksize,
+                                          (fsw_u8 *)buffer + (UINTN)done * vol->phys_blocksize);
+        Volume->LastIOStatus = Status;
+        if (EFI_ERROR(Status))
+            return FSW_IO_ERROR;
+    }
+    
+    if (Volume->DiskIo2 != NULL) {
+        Volume->AsyncNextBno = phys_bno + count;
+        if (sequential)
+            fsw_efi_async_readahead(vol, phys_bno + count, count);
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Prepare the read-ahead requests of a volume that has Disk I/O 2. Each request gets
+ * its completion event here; if an event cannot be created, Disk I/O 2 is not used.
+ */
+
+VOID fsw_efi_async_init(IN FSW_VOLUME_DATA *Volume)
+{
+    EFI_STATUS          Status;
+    UINTN               i;
+    
+    for (i = 0; i < FSW_EFI_ASYNC_DEPTH; i++) {
+        Status = BS->CreateEvent(0, 0, NULL, NULL, &Volume->Async[i].Token.Event);
+        if (EFI_ERROR(Status)) {
+            fsw_efi_async_shutdown(Volume);
+            Volume->DiskIo2 = NULL;
+            return;
+        }
+    }
+}
+
+/**
+ * Release the read-ahead requests of a volume. Requests still in flight are waited
+ * for first, since the device writes into their buffers and tokens.
+ */
+
+VOID fsw_efi_async_shutdown(IN FSW_VOLUME_DATA *Volume)
+{
+    FSW_EFI_ASYNC_REQUEST *Request;
+    UINTN               i;
+    
+    for (i = 0; i < FSW_EFI_ASYNC_DEPTH; i++) {
+        Request = &Volume->Async[i];
+        if (Request->Pending)
+            fsw_efi_async_complete(Request, TRUE);
+        Request->Pending = FALSE;
+        if (Request->Token.Event != NULL) {
+            BS->CloseEvent(Request->Token.Event);
+            Request->Token.Event = NULL;
+        }
+        if (Request->Buffer != NULL) {
+            FreePool(Request->Buffer);
+            Request->Buffer = NULL;
+            Request->Capacity = 0;
+        }
+    }
+}
+
+/**
+ * Check whether a pending read-ahead request has completed, optionally waiting for it.
+ * The event is polled rather than waited on with WaitForEvent, which is not allowed
+ * at TPL_CALLBACK. Checking resets the event, so completion is remembered in Done.
+ */
+
+BOOLEAN fsw_efi_async_complete(IN FSW_EFI_ASYNC_REQUEST *Request, IN BOOLEAN Wait)
+{
+    if (!Request->Done) {
+        while (BS->CheckEvent(Request->Token.Event) == EFI_NOT_READY) {
+            if (!Wait)
+                return FALSE;
+        }
+        Request->Done = TRUE;
+    }
+    return TRUE;
+}
+
+/**
+ * Free the buffer of an idle read-ahead request if it is larger than FSW_EFI_ASYNC_MAX_SIZE,
+ * so that a volume does not keep more memory than the request size limit allows.
+ */
+
+VOID fsw_efi_async_trim(IN FSW_EFI_ASYNC_REQUEST *Request)
+{
+    if (Request->Buffer != NULL && Request->Capacity > FSW_EFI_ASYNC_MAX_SIZE) {
+        FreePool(Request->Buffer);
+        Request->Buffer = NULL;
+        Request->Capacity = 0;
+    }
+}
+
+/**
+ * Queue read-ahead requests for the FSW_EFI_ASYNC_DEPTH runs of count blocks starting
+ * at phys_bno. Runs are limited to FSW_EFI_ASYNC_MAX_SIZE bytes; a caller asking for
+ * more takes the leading part from the request and reads the rest itself. Runs already
+ * in flight are left alone. Requests outside that window are recycled once they have
+ * completed; the ones still busy are skipped, so this never blocks on the device.
+ * Queueing stops at the first error, e.g. at the end of the media.
+ */
+
+VOID fsw_efi_async_readahead(IN struct fsw_volume *vol, IN fsw_u64 phys_bno, IN fsw_u32 count)
+{
+    EFI_STATUS          Status;
+    FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)vol->host_data;
+    FSW_EFI_ASYNC_REQUEST *Request;
+    fsw_u64             bno, window_end;
+    UINTN               size, i, j;
+    
+    if (count > FSW_EFI_ASYNC_MAX_SIZE / vol->phys_blocksize)
+        count = FSW_EFI_ASYNC_MAX_SIZE / vol->phys_blocksize;
+    if (count == 0)
+        count = 1;
+    size = (UINTN)count * vol->phys_blocksize;
+    window_end = phys_bno + (fsw_u64)count * FSW_EFI_ASYNC_DEPTH;
+    
+    for (i = 0, bno = phys_bno; i < FSW_EFI_ASYNC_DEPTH; i++, bno += count) {
+        // skip runs that are already in flight
+        for (j = 0; j < FSW_EFI_ASYNC_DEPTH; j++) {
+            if (Volume->Async[j].Pending && Volume->Async[j].PhysBno == bno)
+                break;
+        }
+        if (j < FSW_EFI_ASYNC_DEPTH)
+            continue;
+        
+        // find a request to use: idle, or stale and already completed
+        Request = NULL;
+        for (j = 0; j < FSW_EFI_ASYNC_DEPTH; j++) {
+            Request = &Volume->Async[j];
+            if (!Request->Pending)
+                break;
+            if ((Request->PhysBno < phys_bno || Request->PhysBno >= window_end) &&
+                fsw_efi_async_complete(Request, FALSE))
+                break;
+        }
+        if (j == FSW_EFI_ASYNC_DEPTH)
+            return;
+        Request->Pending = FALSE;
+        fsw_efi_async_trim(Request);
+        
+        if (Request->Capacity < size) {
+            if (Request->Buffer != NULL)
+                FreePool(Request->Buffer);
+            Request->Buffer = AllocatePool(size);
+            Request->Capacity = (Request->Buffer != NULL) ? size : 0;
+            if (Request->Buffer == NULL)
+                return;
+        }
+        
+        Request->PhysBno = bno;
+        Request->Count   = count;
+        Request->Done    = FALSE;
+        Request->Token.TransactionStatus = EFI_SUCCESS;
+        Status = Volume->DiskIo2->ReadDiskEx(Volume->DiskIo2, Volume->MediaId,
+                                             (UINT64)bno * vol->phys_blocksize,
+                                             &Request->Token,
+                                             size,
+                                             Request->Buffer);
+        if (EFI_ERROR(Status))
+            return;
+        Request->Pending = TRUE;
+    }
+}
+
 /**
  * Map FSW status codes to EFI status codes. The FSW_IO_ERROR code is only produced
  * by fsw_efi_read_block, so we map it back to the EFI status code remembered from
@@ -529,6 +787,8 @@ EFI_STATUS EFIAPI fsw_efi_FileHandle_Close(IN EFI_FILE *This)
     Print(L"fsw_efi_FileHandle_Close\n");
 #endif
     
+    if (File->Type == FSW_EFI_FILE_TYPE_DIR)
+        fsw_efi_dir_drop_batch(File);
     fsw_shandle_close(&File->shand);
     FreePool(File);
     
@@ -829,26 +1089,71 @@ EFI_STATUS fsw_efi_dir_read(IN FSW_FILE_DATA *File,
     Print(L"fsw_efi_dir_read...\n");
 #endif
     
-    // read the next entry
-    Status = fsw_efi_map_status(fsw_dnode_dir_read(&File->shand, &dno),
-                                Volume);
-    if (Status == EFI_NOT_FOUND) {
-        // end of directory
-        *BufferSize = 0;
+    // get the next entry, reading ahead a batch of entries as needed
+    if (File->BatchIndex >= File->BatchCount) {
+        Status = fsw_efi_dir_fill_batch(File);
+        if (Status == EFI_NOT_FOUND) {
+            // end of directory
+            *BufferSize = 0;
 #if DEBUG_LEVEL
-        Print(L"...no more entries\n");
+            Print(L"...no more entries\n");
 #endif
-        return EFI_SUCCESS;
+            return EFI_SUCCESS;
+        }
+        if (EFI_ERROR(Status))
+            return Status;
     }
-    if (EFI_ERROR(Status))
-        return Status;
+    dno = File->Batch[File->BatchIndex];
     
-    // get info into buffer
+    // get info into buffer; the entry stays current if the buffer is too small
     Status = fsw_efi_dnode_fill_FileInfo(Volume, dno, BufferSize, Buffer);
-    fsw_dnode_release(dno);
+    if (Status != EFI_BUFFER_TOO_SMALL) {
+        File->BatchIndex++;
+        fsw_dnode_release(dno);
+    }
     return Status;
 }
 
+/**
+ * Read the next batch of entries from a directory and fill them in one go,
+ * so that inode information stored close together on disk is read only once.
+ */
+
+EFI_STATUS fsw_efi_dir_fill_batch(IN FSW_FILE_DATA *File)
+{
+    EFI_STATUS          Status;
+    FSW_VOLUME_DATA     *Volume = (FSW_VOLUME_DATA *)File->shand.dnode->vol->host_data;
+    
+    File->BatchCount = 0;
+    File->BatchIndex = 0;
+    while (File->BatchCount < FSW_DNODE_FILL_BATCH) {
+        Status = fsw_efi_map_status(fsw_dnode_dir_read(&File->shand, &File->Batch[File->BatchCount]),
+                                    Volume);
+        if (EFI_ERROR(Status)) {
+            if (File->BatchCount == 0)
+                return Status;
+            break;      // report the error once the entries read so far are used up
+        }
+        File->BatchCount++;
+    }
+    
+    // errors are reported by fsw_dnode_fill for each single entry
+    fsw_dnode_fill_many(File->Batch, (fsw_u32)File->BatchCount);
+    return EFI_SUCCESS;
+}
+
+/**
+ * Release the directory entries that were read ahead but not yet returned.
+ */
+
+VOID fsw_efi_dir_drop_batch(IN FSW_FILE_DATA *File)
+{
+    while (File->BatchIndex < File->BatchCount)
+        fsw_dnode_release(File->Batch[File->BatchIndex++]);
+    File->BatchCount = 0;
+    File->BatchIndex = 0;
+}
+
 /**
  * Set file position for directories. The only allowed set position operation
  * for directories is to rewind the directory completely by setting the
@@ -859,6 +1164,7 @@ EFI_STATUS fsw_efi_dir_setpos(IN FSW_FILE_DATA *File,
                               IN UINT64 Position)
 {
     if (Position == 0) {
+        fsw_efi_dir_drop_batch(File);
         File->shand.pos = 0;
         return EFI_SUCCESS;
     } else {
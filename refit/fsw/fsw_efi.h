@@ -41,6 +41,100 @@
 #include "fsw_core.h"
 
 
+#ifndef FSW_EFI_ASYNC_DEPTH
+/** Number of read-ahead requests the host keeps in flight per volume via Disk I/O 2. */
+#define FSW_EFI_ASYNC_DEPTH (4)
+#endif
+
+#ifndef FSW_EFI_ASYNC_MAX_SIZE
+/** Maximum size in bytes of one read-ahead request issued via Disk I/O 2. */
+#define FSW_EFI_ASYNC_MAX_SIZE FSW_READAHEAD_DEFAULT_SIZE
+#endif
+
+
+#ifndef EFI_DISK_IO2_PROTOCOL_GUID
+
+//
+// Disk I/O 2 protocol (UEFI 2.4). The EFI toolkit headers predate it, so the parts
+// we use are declared here.
+//
+
+#define EFI_DISK_IO2_PROTOCOL_GUID \
+    { 0x151c8eae, 0x7f2c, 0x472c, { 0x9e, 0x54, 0x98, 0x28, 0x19, 0x4f, 0x6a, 0x88 } }
+
+struct _EFI_DISK_IO2_PROTOCOL;
+
+/**
+ * Disk I/O 2 token. If Event is not NULL, the request is queued and Event is signaled
+ * when it completes; TransactionStatus then holds the outcome.
+ */
+
+typedef struct {
+    EFI_EVENT                   Event;              //!< Event signaled on completion
+    EFI_STATUS                  TransactionStatus;  //!< Status of the completed transaction
+} EFI_DISK_IO2_TOKEN;
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_CANCEL_EX) (
+    IN struct _EFI_DISK_IO2_PROTOCOL    *This
+    );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_READ_EX) (
+    IN struct _EFI_DISK_IO2_PROTOCOL    *This,
+    IN UINT32                           MediaId,
+    IN UINT64                           Offset,
+    IN OUT EFI_DISK_IO2_TOKEN           *Token,
+    IN UINTN                            BufferSize,
+    OUT VOID                            *Buffer
+    );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_WRITE_EX) (
+    IN struct _EFI_DISK_IO2_PROTOCOL    *This,
+    IN UINT32                           MediaId,
+    IN UINT64                           Offset,
+    IN OUT EFI_DISK_IO2_TOKEN           *Token,
+    IN UINTN                            BufferSize,
+    IN VOID                             *Buffer
+    );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_FLUSH_EX) (
+    IN struct _EFI_DISK_IO2_PROTOCOL    *This,
+    IN OUT EFI_DISK_IO2_TOKEN           *Token
+    );
+
+typedef struct _EFI_DISK_IO2_PROTOCOL {
+    UINT64                      Revision;
+    EFI_DISK_CANCEL_EX          Cancel;
+    EFI_DISK_READ_EX            ReadDiskEx;
+    EFI_DISK_WRITE_EX           WriteDiskEx;
+    EFI_DISK_FLUSH_EX           FlushDiskEx;
+} EFI_DISK_IO2_PROTOCOL;
+
+#endif
+
+
+/**
+ * EFI Host: Asynchronous read-ahead request issued through Disk I/O 2.
+ */
+
+typedef struct {
+    EFI_DISK_IO2_TOKEN          Token;          //!< Disk I/O 2 token, Event is created at mount time
+    fsw_u64                     PhysBno;        //!< First physical block of the request
+    fsw_u32                     Count;          //!< Number of physical blocks in the request
+    UINTN                       Capacity;       //!< Allocated size of Buffer in bytes
+    VOID                        *Buffer;        //!< Data buffer the request reads into
+    BOOLEAN                     Pending;        //!< Request was issued and its data not yet consumed
+    BOOLEAN                     Done;           //!< Completion of the pending request was observed
+} FSW_EFI_ASYNC_REQUEST;
+
+
 /**
  * EFI Host: Private per-volume structure.
  */
@@ -55,6 +149,10 @@ typedef struct {
     UINT32                      MediaId;        //!< The media ID from the Block I/O protocol
     EFI_STATUS                  LastIOStatus;   //!< Last status from Disk I/O
     
+    EFI_DISK_IO2_PROTOCOL       *DiskIo2;       //!< The Disk I/O 2 protocol for queued reads, NULL if not available
+    FSW_EFI_ASYNC_REQUEST       Async[FSW_EFI_ASYNC_DEPTH];     //!< Read-ahead requests issued via DiskIo2
+    fsw_u64                     AsyncNextBno;   //!< Block following the last run read, for sequential detection
+    
     struct fsw_volume           *vol;           //!< FSW volume structure
     
 } FSW_VOLUME_DATA;
@@ -76,6 +174,10 @@ typedef struct {
     UINTN                       Type;           //!< File type used for dispatchinng
     struct fsw_shandle          shand;          //!< FSW handle for this file
     
+    struct fsw_dnode            *Batch[FSW_DNODE_FILL_BATCH];   //!< Directories: entries read ahead and filled as one batch
+    UINTN                       BatchCount;     //!< Directories: number of entries in the batch
+    UINTN                       BatchIndex;     //!< Directories: next entry of the batch to return
+    
 } FSW_FILE_DATA;
 
 /** File type: regular file. */
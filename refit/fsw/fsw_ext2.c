@@ -29,19 +29,48 @@
 static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol);
 static void         fsw_ext2_volume_free(struct fsw_ext2_volume *vol);
 static fsw_status_t fsw_ext2_volume_stat(struct fsw_ext2_volume *vol, struct fsw_volume_stat *sb);
+static fsw_status_t fsw_ext2_load_gdesc_block(struct fsw_ext2_volume *vol, fsw_u32 gdesc_block);
 
 static fsw_status_t fsw_ext2_dnode_fill(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno);
 static void         fsw_ext2_dnode_free(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno);
+static fsw_status_t fsw_ext2_dnode_locate(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                          fsw_u64 *phys_bno);
+static fsw_status_t fsw_ext2_inode_location(struct fsw_ext2_volume *vol, fsw_u32 ino,
+                                            fsw_u64 *ino_bno_out, fsw_u32 *ino_index_out);
 static fsw_status_t fsw_ext2_dnode_stat(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                         struct fsw_dnode_stat *sb);
 static fsw_status_t fsw_ext2_get_extent(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                         struct fsw_extent *extent);
+static fsw_status_t fsw_ext2_build_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno);
+static fsw_status_t fsw_ext2_add_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                      fsw_u32 *ptrs, fsw_u32 ptr_count, int depth,
+                                      fsw_u32 *log_bno, fsw_u32 file_bcnt);
+static fsw_status_t fsw_ext2_add_extent_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                             struct ext4_extent_header *header, fsw_u32 node_size, int depth,
+                                             fsw_u32 *log_bno, fsw_u32 file_bcnt);
+static fsw_status_t fsw_ext2_append_run(struct fsw_ext2_dnode *dno, fsw_u32 log_start, fsw_u32 log_count,
+                                        fsw_u64 phys_start);
 
 static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                         struct fsw_string *lookup_name, struct fsw_ext2_dnode **child_dno);
 static fsw_status_t fsw_ext2_dir_read(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                       struct fsw_shandle *shand, struct fsw_ext2_dnode **child_dno);
 static fsw_status_t fsw_ext2_read_dentry(struct fsw_shandle *shand, struct ext2_dir_entry *entry);
+static int          fsw_ext2_dentry_type(struct fsw_ext2_volume *vol, struct ext2_dir_entry *entry);
+static fsw_status_t fsw_ext2_dx_lookup(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                       struct fsw_string *lookup_name, struct fsw_ext2_dnode **child_dno);
+static fsw_status_t fsw_ext2_dx_block_get(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                          fsw_u32 log_bno, fsw_u32 cache_level,
+                                          fsw_u64 *phys_bno_out, void **buffer_out);
+static fsw_status_t fsw_ext2_dx_node_entries(struct fsw_ext2_volume *vol, void *buffer, fsw_u32 offset,
+                                             struct ext2_dx_entry **entries_out, fsw_u32 *count_out);
+static fsw_status_t fsw_ext2_dx_search_leaf(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                            fsw_u32 log_bno, struct fsw_string *lookup_name,
+                                            struct fsw_ext2_dnode **child_dno);
+static fsw_u32      fsw_ext2_dx_hash(struct fsw_ext2_volume *vol, int hash_version, fsw_u8 *name, int len);
+static void         fsw_ext2_dx_str2hashbuf(fsw_u8 *name, int len, fsw_u32 *buf, int num, int unsigned_chars);
+static void         fsw_ext2_dx_half_md4(fsw_u32 *buf, fsw_u32 *in);
+static void         fsw_ext2_dx_tea(fsw_u32 *buf, fsw_u32 *in);
 
 static fsw_status_t fsw_ext2_readlink(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                       struct fsw_string *link);
@@ -65,6 +94,8 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(ext2) = {
     fsw_ext2_dir_lookup,
     fsw_ext2_dir_read,
     fsw_ext2_readlink,
+    NULL,
+    fsw_ext2_dnode_locate,
 };
 
 /**
@@ -77,8 +108,6 @@ static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol)
     fsw_status_t    status;
     void            *buffer;
     fsw_u32         blocksize;
-    fsw_u32         groupcnt, groupno, gdesc_per_block, gdesc_bno, gdesc_index;
-    struct ext2_group_desc *gdesc;
     int             i;
     struct fsw_string s;
     
@@ -102,9 +131,21 @@ static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol)
         vol->sb->s_rev_level != EXT2_DYNAMIC_REV)
         return FSW_UNSUPPORTED;
     if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV &&
-        (vol->sb->s_feature_incompat & ~(EXT2_FEATURE_INCOMPAT_FILETYPE | EXT3_FEATURE_INCOMPAT_RECOVER)))
+        (vol->sb->s_feature_incompat & ~(EXT2_FEATURE_INCOMPAT_FILETYPE | EXT3_FEATURE_INCOMPAT_RECOVER |
+                                         EXT3_FEATURE_INCOMPAT_EXTENTS | EXT4_FEATURE_INCOMPAT_64BIT |
+                                         EXT4_FEATURE_INCOMPAT_FLEX_BG)))
         return FSW_UNSUPPORTED;
     
+    // volumes with 64-bit block numbers have larger group descriptors
+    vol->desc_size = EXT2_MIN_DESC_SIZE;
+    if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV &&
+        (vol->sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT)) {
+        vol->desc_size = vol->sb->s_desc_size;
+        if (vol->desc_size < EXT4_MIN_DESC_SIZE_64BIT || vol->desc_size > EXT4_MAX_DESC_SIZE ||
+            (vol->desc_size & (vol->desc_size - 1)) != 0)
+            return FSW_VOLUME_CORRUPTED;
+    }
+    
     /*
      if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV &&
          (vol->sb->s_feature_incompat & EXT3_FEATURE_INCOMPAT_RECOVER))
@@ -130,24 +171,16 @@ static fsw_status_t fsw_ext2_volume_mount(struct fsw_ext2_volume *vol)
     if (status)
         return status;
     
-    // read the group descriptors to get inode table offsets
-    groupcnt = ((vol->sb->s_inodes_count - 2) / vol->sb->s_inodes_per_group) + 1;
-    gdesc_per_block = (vol->g.phys_blocksize / sizeof(struct ext2_group_desc));
+    // group descriptors are read on demand, see fsw_ext2_load_gdesc_block
+    vol->group_count = ((vol->sb->s_inodes_count - 2) / vol->sb->s_inodes_per_group) + 1;
+    vol->gdesc_per_block = (vol->g.phys_blocksize / vol->desc_size);
     
-    status = fsw_alloc(sizeof(fsw_u32) * groupcnt, &vol->inotab_bno);
+    status = fsw_alloc(sizeof(fsw_u64) * vol->group_count, &vol->inotab_bno);
+    if (status)
+        return status;
+    status = fsw_alloc_zero((vol->group_count / vol->gdesc_per_block + 8) / 8, (void **)&vol->gdesc_loaded);
     if (status)
         return status;
-    for (groupno = 0; groupno < groupcnt; groupno++) {
-        // get the block group descriptor
-        gdesc_bno = (vol->sb->s_first_data_block + 1) + groupno / gdesc_per_block;
-        gdesc_index = groupno % gdesc_per_block;
-        status = fsw_block_get(vol, gdesc_bno, 1, (void **)&buffer);
-        if (status)
-            return status;
-        gdesc = ((struct ext2_group_desc *)(buffer)) + gdesc_index;
-        vol->inotab_bno[groupno] = gdesc->bg_inode_table;
-        fsw_block_release(vol, gdesc_bno, buffer);
-    }
     
     // setup the root dnode
     status = fsw_dnode_create_root(vol, EXT2_ROOT_INO, &vol->g.root);
@@ -171,6 +204,41 @@ static void fsw_ext2_volume_free(struct fsw_ext2_volume *vol)
         fsw_free(vol->sb);
     if (vol->inotab_bno)
         fsw_free(vol->inotab_bno);
+    if (vol->gdesc_loaded)
+        fsw_free(vol->gdesc_loaded);
+}
+
+/**
+ * Read a block of group descriptors and record the inode table locations of its
+ * groups. This internal function is called when an inode in a group is needed for
+ * the first time, so mounting doesn't have to read all descriptors of the volume.
+ */
+
+static fsw_status_t fsw_ext2_load_gdesc_block(struct fsw_ext2_volume *vol, fsw_u32 gdesc_block)
+{
+    fsw_status_t    status;
+    fsw_u32         gdesc_bno, groupno, gdesc_index;
+    fsw_u8          *buffer;
+    struct ext2_group_desc *gdesc;
+    
+    gdesc_bno = (vol->sb->s_first_data_block + 1) + gdesc_block;
+    status = fsw_block_get(vol, gdesc_bno, 1, (void **)&buffer);
+    if (status)
+        return status;
+    
+    for (gdesc_index = 0; gdesc_index < vol->gdesc_per_block; gdesc_index++) {
+        groupno = gdesc_block * vol->gdesc_per_block + gdesc_index;
+        if (groupno >= vol->group_count)
+            break;
+        gdesc = (struct ext2_group_desc *)(buffer + gdesc_index * vol->desc_size);
+        vol->inotab_bno[groupno] = gdesc->bg_inode_table;
+        if (vol->desc_size >= EXT4_MIN_DESC_SIZE_64BIT)
+            vol->inotab_bno[groupno] |= (fsw_u64)((struct ext4_group_desc *)gdesc)->bg_inode_table_hi << 32;
+    }
+    fsw_block_release(vol, gdesc_bno, buffer);
+    
+    vol->gdesc_loaded[gdesc_block >> 3] |= 1 << (gdesc_block & 7);
+    return FSW_SUCCESS;
 }
 
 /**
@@ -179,8 +247,16 @@ static void fsw_ext2_volume_free(struct fsw_ext2_volume *vol)
 
 static fsw_status_t fsw_ext2_volume_stat(struct fsw_ext2_volume *vol, struct fsw_volume_stat *sb)
 {
-    sb->total_bytes = (fsw_u64)vol->sb->s_blocks_count      * vol->g.log_blocksize;
-    sb->free_bytes  = (fsw_u64)vol->sb->s_free_blocks_count * vol->g.log_blocksize;
+    fsw_u64         blocks_count, free_blocks_count;
+    
+    blocks_count = vol->sb->s_blocks_count;
+    free_blocks_count = vol->sb->s_free_blocks_count;
+    if (vol->desc_size >= EXT4_MIN_DESC_SIZE_64BIT) {
+        blocks_count |= (fsw_u64)vol->sb->s_blocks_count_hi << 32;
+        free_blocks_count |= (fsw_u64)vol->sb->s_free_blocks_count_hi << 32;
+    }
+    sb->total_bytes = blocks_count      * vol->g.log_blocksize;
+    sb->free_bytes  = free_blocks_count * vol->g.log_blocksize;
     return FSW_SUCCESS;
 }
 
@@ -195,20 +271,19 @@ static fsw_status_t fsw_ext2_volume_stat(struct fsw_ext2_volume *vol, struct fsw
 static fsw_status_t fsw_ext2_dnode_fill(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno)
 {
     fsw_status_t    status;
-    fsw_u32         groupno, ino_in_group, ino_bno, ino_index;
+    fsw_u64         ino_bno;
+    fsw_u32         ino_index;
     fsw_u8          *buffer;
     
     if (dno->raw)
         return FSW_SUCCESS;
     
-    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext2_dnode_fill: inode %d\n"), dno->g.dnode_id));
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext2_dnode_fill: inode %lld\n"), dno->g.dnode_id));
     
     // read the inode block
-    groupno = (dno->g.dnode_id - 1) / vol->sb->s_inodes_per_group;
-    ino_in_group = (dno->g.dnode_id - 1) % vol->sb->s_inodes_per_group;
-    ino_bno = vol->inotab_bno[groupno] +
-        ino_in_group / (vol->g.phys_blocksize / vol->inode_size);
-    ino_index = ino_in_group % (vol->g.phys_blocksize / vol->inode_size);
+    status = fsw_ext2_inode_location(vol, dno->g.dnode_id, &ino_bno, &ino_index);
+    if (status)
+        return status;
     status = fsw_block_get(vol, ino_bno, 2, (void **)&buffer);
     if (status)
         return status;
@@ -218,10 +293,13 @@ static fsw_status_t fsw_ext2_dnode_fill(struct fsw_ext2_volume *vol, struct fsw_
     fsw_block_release(vol, ino_bno, buffer);
     if (status)
         return status;
+    fsw_dnode_account(dno, 0, vol->inode_size);
     
     // get info from the inode
     dno->g.size = dno->raw->i_size;
-    // TODO: check docs for 64-bit sized files
+    // regular files keep the high 32 bits of the size in the former i_dir_acl field
+    if (vol->sb->s_rev_level == EXT2_DYNAMIC_REV && S_ISREG(dno->raw->i_mode))
+        dno->g.size |= (fsw_u64)dno->raw->i_size_high << 32;
     if (S_ISREG(dno->raw->i_mode))
         dno->g.type = FSW_DNODE_TYPE_FILE;
     else if (S_ISDIR(dno->raw->i_mode))
@@ -234,6 +312,52 @@ static fsw_status_t fsw_ext2_dnode_fill(struct fsw_ext2_volume *vol, struct fsw_
     return FSW_SUCCESS;
 }
 
+/**
+ * Find the inode table block and the index within that block of an inode.
+ * Loads the group descriptor block covering the inode's group if necessary.
+ */
+
+static fsw_status_t fsw_ext2_inode_location(struct fsw_ext2_volume *vol, fsw_u32 ino,
+                                            fsw_u64 *ino_bno_out, fsw_u32 *ino_index_out)
+{
+    fsw_status_t    status;
+    fsw_u32         groupno, ino_in_group, gdesc_block;
+    
+    // make sure the group's descriptor has been read
+    groupno = (ino - 1) / vol->sb->s_inodes_per_group;
+    ino_in_group = (ino - 1) % vol->sb->s_inodes_per_group;
+    if (groupno >= vol->group_count)
+        return FSW_VOLUME_CORRUPTED;
+    gdesc_block = groupno / vol->gdesc_per_block;
+    if (!(vol->gdesc_loaded[gdesc_block >> 3] & (1 << (gdesc_block & 7)))) {
+        status = fsw_ext2_load_gdesc_block(vol, gdesc_block);
+        if (status)
+            return status;
+    }
+    
+    *ino_bno_out = vol->inotab_bno[groupno] +
+        ino_in_group / (vol->g.phys_blocksize / vol->inode_size);
+    *ino_index_out = ino_in_group % (vol->g.phys_blocksize / vol->inode_size);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Report the inode table block holding a dnode's inode. Used by the core to
+ * order batched fills. Returns FSW_INVALID_BNO for dnodes that are already filled.
+ */
+
+static fsw_status_t fsw_ext2_dnode_locate(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                          fsw_u64 *phys_bno)
+{
+    fsw_u32         ino_index;
+    
+    if (dno->raw) {
+        *phys_bno = FSW_INVALID_BNO;
+        return FSW_SUCCESS;
+    }
+    return fsw_ext2_inode_location(vol, dno->g.dnode_id, phys_bno, &ino_index);
+}
+
 /**
  * Free the dnode data structure. Called by the core when deallocating a dnode
  * structure to release the memory used by the file system type specific part
@@ -244,6 +368,8 @@ static void fsw_ext2_dnode_free(struct fsw_ext2_volume *vol, struct fsw_ext2_dno
 {
     if (dno->raw)
         fsw_free(dno->raw);
+    if (dno->runs)
+        fsw_free(dno->runs);
 }
 
 /**
@@ -273,98 +399,268 @@ static fsw_status_t fsw_ext2_dnode_stat(struct fsw_ext2_volume *vol, struct fsw_
  * the requested logical block number.
  *
  * The ext2 file system does not use extents, but stores a list of block numbers
- * using the usual direct, indirect, double-indirect, triple-indirect scheme. To
- * optimize access, this function checks if the following file blocks are mapped
- * to consecutive disk blocks and returns a combined extent if possible.
+ * using the usual direct, indirect, double-indirect, triple-indirect scheme. On first
+ * use, the whole list is condensed into runs of consecutive disk blocks which are kept
+ * with the dnode (see fsw_ext2_build_runs). All later calls, from any shandle on the
+ * dnode, just search that list and don't need to read indirect blocks again.
  */
 
 static fsw_status_t fsw_ext2_get_extent(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
                                         struct fsw_extent *extent)
 {
     fsw_status_t    status;
-    fsw_u32         bno, release_bno, buf_bcnt, file_bcnt;
-    fsw_u32         *buffer;
-    int             path[5], i;
+    fsw_u32         bno, lo, hi, mid;
+    struct fsw_ext2_run *run;
     
     // Preconditions: The caller has checked that the requested logical block
     //  is within the file's size. The dnode has complete information, i.e.
     //  fsw_ext2_dnode_read_info was called successfully on it.
     
-    extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
-    extent->log_count = 1;
+    if (dno->runs == NULL) {
+        status = fsw_ext2_build_runs(vol, dno);
+        if (status)
+            return status;
+    }
+    
+    // binary search for the last run starting at or before the requested block
     bno = extent->log_start;
+    lo = 0;
+    hi = dno->run_count;
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (dno->runs[mid].log_start <= bno)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    run = &dno->runs[lo];
+    if (bno < run->log_start || bno >= run->log_start + run->log_count)
+        return FSW_VOLUME_CORRUPTED;
     
-    // try direct block pointers in the inode
-    if (bno < EXT2_NDIR_BLOCKS) {
-        path[0] = bno;
-        path[1] = -1;
+    // return the rest of the run as the extent
+    extent->log_count = run->log_start + run->log_count - bno;
+    if (run->phys_start == 0) {
+        extent->type = FSW_EXTENT_TYPE_SPARSE;
     } else {
-        bno -= EXT2_NDIR_BLOCKS;
-        
-        // try indirect block
-        if (bno < vol->ind_bcnt) {
-            path[0] = EXT2_IND_BLOCK;
-            path[1] = bno;
-            path[2] = -1;
+        extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
+        extent->phys_start = run->phys_start + (bno - run->log_start);
+    }
+    return FSW_SUCCESS;
+}
+
+/**
+ * Build the block map of a file. The direct block pointers in the inode and the whole
+ * tree of indirect blocks are walked once, up to the end of the file. Consecutive blocks
+ * are merged into runs, and so are consecutive holes. Each indirect block is read once.
+ * For files with an ext4 extent tree, the extents are collected instead.
+ */
+
+static fsw_status_t fsw_ext2_build_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno)
+{
+    fsw_status_t    status;
+    fsw_u32         log_bno, file_bcnt;
+    int             depth;
+    
+    file_bcnt = (fsw_u32)FSW_U64_DIV(dno->g.size + vol->g.log_blocksize - 1, vol->g.log_blocksize);
+    dno->run_count = 0;
+    
+    log_bno = 0;
+    if (dno->raw->i_flags & EXT4_EXTENTS_FL) {
+        // extent tree rooted in the inode, plus a hole up to the end of the file
+        status = fsw_ext2_add_extent_runs(vol, dno, (struct ext4_extent_header *)dno->raw->i_block,
+                                          sizeof(dno->raw->i_block), -1, &log_bno, file_bcnt);
+        if (status == FSW_SUCCESS && log_bno < file_bcnt)
+            status = fsw_ext2_append_run(dno, log_bno, file_bcnt - log_bno, 0);
+    } else {
+        // direct blocks, then the indirect, double-indirect and triple-indirect trees
+        status = fsw_ext2_add_runs(vol, dno, dno->raw->i_block, EXT2_NDIR_BLOCKS, 0, &log_bno, file_bcnt);
+        for (depth = 1; depth <= 3 && status == FSW_SUCCESS; depth++)
+            status = fsw_ext2_add_runs(vol, dno, dno->raw->i_block + EXT2_IND_BLOCK + depth - 1, 1, depth,
+                                       &log_bno, file_bcnt);
+    }
+    if (status == FSW_SUCCESS && dno->run_count == 0)
+        status = fsw_ext2_append_run(dno, 0, 1, 0);     // keep get_extent's search simple for empty files
+    
+    if (status) {
+        if (dno->runs)
+            fsw_free(dno->runs);
+        fsw_dnode_account(dno, sizeof(struct fsw_ext2_run) * dno->run_capacity, 0);
+        dno->runs = NULL;
+        dno->run_count = dno->run_capacity = 0;
+    }
+    return status;
+}
+
+/**
+ * Add the blocks referenced by an array of block pointers to a file's block map. With
+ * a depth of zero, the pointers refer to data blocks. Otherwise, they refer to indirect
+ * blocks of the given depth, which are read and processed recursively. A null pointer
+ * is a hole that covers all blocks it would address. *log_bno is the logical block that
+ * the first pointer maps and is advanced; processing stops at the end of the file.
+ */
+
+static fsw_status_t fsw_ext2_add_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                      fsw_u32 *ptrs, fsw_u32 ptr_count, int depth,
+                                      fsw_u32 *log_bno, fsw_u32 file_bcnt)
+{
+    fsw_status_t    status;
+    fsw_u32         i, span, count;
+    fsw_u32         *buffer;
+    int             d;
+    
+    // blocks addressed by one pointer; saturated because ind_bcnt^3 overflows 32 bits
+    //  for block sizes above 4 KiB, and no run can exceed the file anyway
+    span = 1;
+    for (d = 0; d < depth; d++) {
+        if (span > file_bcnt / vol->ind_bcnt) {
+            span = file_bcnt;
+            break;
+        }
+        span *= vol->ind_bcnt;
+    }
+    
+    for (i = 0; i < ptr_count && *log_bno < file_bcnt; i++) {
+        if (depth == 0 || ptrs[i] == 0) {
+            count = file_bcnt - *log_bno;
+            if (count > span)
+                count = span;
+            status = fsw_ext2_append_run(dno, *log_bno, count, ptrs[i]);
+            if (status)
+                return status;
+            *log_bno += count;
+            
         } else {
-            bno -= vol->ind_bcnt;
-        
-            // try double-indirect block
-            if (bno < vol->dind_bcnt) {
-                path[0] = EXT2_DIND_BLOCK;
-                path[1] = bno / vol->ind_bcnt;
-                path[2] = bno % vol->ind_bcnt;
-                path[3] = -1;
-            } else {
-                bno -= vol->dind_bcnt;
-                
-                // use the triple-indirect block
-                path[0] = EXT2_TIND_BLOCK;
-                path[1] = bno / vol->dind_bcnt;
-                path[2] = (bno / vol->ind_bcnt) % vol->ind_bcnt;
-                path[3] = bno % vol->ind_bcnt;
-                path[4] = -1;
+            status = fsw_block_get(vol, ptrs[i], 1, (void **)&buffer);
+            if (status)
+                return status;
+            status = fsw_ext2_add_runs(vol, dno, buffer, vol->ind_bcnt, depth - 1, log_bno, file_bcnt);
+            fsw_block_release(vol, ptrs[i], buffer);
+            if (status)
+                return status;
+        }
+    }
+    
+    return FSW_SUCCESS;
+}
+
+/**
+ * Add the extents of an ext4 extent tree node to a file's block map. Index nodes are
+ * followed recursively, each tree block is read once. Gaps between extents and
+ * uninitialized extents become holes. The expected depth of the node is checked
+ * unless it is negative (for the root node in the inode). *log_bno is the first
+ * logical block not mapped yet and is advanced; processing stops at the end of the file.
+ */
+
+static fsw_status_t fsw_ext2_add_extent_runs(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                             struct ext4_extent_header *header, fsw_u32 node_size, int depth,
+                                             fsw_u32 *log_bno, fsw_u32 file_bcnt)
+{
+    fsw_status_t    status;
+    fsw_u32         i, start, count;
+    fsw_u64         phys_bno;
+    struct ext4_extent *extent;
+    struct ext4_extent_idx *index;
+    void            *buffer;
+    
+    if (header->eh_magic != EXT4_EXT_MAGIC || header->eh_entries > header->eh_max ||
+        sizeof(struct ext4_extent_header) + header->eh_max * sizeof(struct ext4_extent) > node_size ||
+        header->eh_depth > EXT4_EXT_MAX_DEPTH || (depth >= 0 && header->eh_depth != depth))
+        return FSW_VOLUME_CORRUPTED;
+    
+    if (header->eh_depth == 0) {
+        // leaf node with the actual extents
+        extent = (struct ext4_extent *)(header + 1);
+        for (i = 0; i < header->eh_entries && *log_bno < file_bcnt; i++, extent++) {
+            start = extent->ee_block;
+            count = extent->ee_len;
+            if (count > EXT4_EXT_INIT_MAX_LEN)
+                count -= EXT4_EXT_INIT_MAX_LEN;
+            if (start < *log_bno)
+                return FSW_VOLUME_CORRUPTED;
+            
+            // hole before the extent
+            if (start > *log_bno) {
+                if (start > file_bcnt)
+                    start = file_bcnt;
+                status = fsw_ext2_append_run(dno, *log_bno, start - *log_bno, 0);
+                if (status)
+                    return status;
+                *log_bno = start;
             }
+            if (count > file_bcnt - *log_bno)
+                count = file_bcnt - *log_bno;
+            if (count == 0)
+                continue;
+            
+            // uninitialized extents read as zeros
+            phys_bno = 0;
+            if (extent->ee_len <= EXT4_EXT_INIT_MAX_LEN)
+                phys_bno = ((fsw_u64)extent->ee_start_hi << 32) | extent->ee_start_lo;
+            status = fsw_ext2_append_run(dno, *log_bno, count, phys_bno);
+            if (status)
+                return status;
+            *log_bno += count;
+        }
+        
+    } else {
+        // index node, descend into the child nodes in order
+        index = (struct ext4_extent_idx *)(header + 1);
+        for (i = 0; i < header->eh_entries && *log_bno < file_bcnt; i++, index++) {
+            phys_bno = ((fsw_u64)index->ei_leaf_hi << 32) | index->ei_leaf_lo;
+            status = fsw_block_get(vol, phys_bno, 1, &buffer);
+            if (status)
+                return status;
+            status = fsw_ext2_add_extent_runs(vol, dno, (struct ext4_extent_header *)buffer, vol->g.log_blocksize,
+                                              header->eh_depth - 1, log_bno, file_bcnt);
+            fsw_block_release(vol, phys_bno, buffer);
+            if (status)
+                return status;
         }
     }
     
-    // follow the indirection path
-    buffer = dno->raw->i_block;
-    buf_bcnt = EXT2_NDIR_BLOCKS;
-    release_bno = 0;
-    for (i = 0; ; i++) {
-        bno = buffer[path[i]];
-        if (bno == 0) {
-            extent->type = FSW_EXTENT_TYPE_SPARSE;
-            if (release_bno)
-                fsw_block_release(vol, release_bno, buffer);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Append blocks to a file's block map, extending the last run if the blocks continue
+ * it on disk (or if both are holes).
+ */
+
+static fsw_status_t fsw_ext2_append_run(struct fsw_ext2_dnode *dno, fsw_u32 log_start, fsw_u32 log_count,
+                                        fsw_u64 phys_start)
+{
+    fsw_status_t    status;
+    struct fsw_ext2_run *run, *new_runs;
+    
+    if (dno->run_count > 0) {
+        run = &dno->runs[dno->run_count - 1];
+        if (run->phys_start == 0 ? (phys_start == 0)
+                                 : (phys_start == run->phys_start + run->log_count)) {
+            run->log_count += log_count;
             return FSW_SUCCESS;
         }
-        if (path[i+1] < 0)
-            break;
-        
-        if (release_bno)
-            fsw_block_release(vol, release_bno, buffer);
-        status = fsw_block_get(vol, bno, 1, (void **)&buffer);
+    }
+    
+    // make room for another run
+    if (dno->run_count >= dno->run_capacity) {
+        status = fsw_alloc(sizeof(struct fsw_ext2_run) * (dno->run_capacity ? dno->run_capacity * 2 : 4),
+                           &new_runs);
         if (status)
             return status;
-        release_bno = bno;
-        buf_bcnt = vol->ind_bcnt;
-    }
-    extent->phys_start = bno;
-    
-    // check if the following blocks can be aggregated into one extent
-    file_bcnt = (fsw_u32)((dno->g.size + vol->g.log_blocksize - 1) & (vol->g.log_blocksize - 1));
-    while (path[i]           + extent->log_count < buf_bcnt &&    // indirect block has more block pointers
-           extent->log_start + extent->log_count < file_bcnt) {   // file has more blocks
-        if (buffer[path[i] + extent->log_count] == buffer[path[i] + extent->log_count - 1] + 1)
-            extent->log_count++;
-        else
-            break;
+        if (dno->runs) {
+            fsw_memcpy(new_runs, dno->runs, sizeof(struct fsw_ext2_run) * dno->run_count);
+            fsw_free(dno->runs);
+        }
+        dno->runs = new_runs;
+        fsw_dnode_account(dno, sizeof(struct fsw_ext2_run) * dno->run_capacity,
+                          sizeof(struct fsw_ext2_run) * (dno->run_capacity ? dno->run_capacity * 2 : 4));
+        dno->run_capacity = dno->run_capacity ? dno->run_capacity * 2 : 4;
     }
     
-    if (release_bno)
-        fsw_block_release(vol, release_bno, buffer);
+    run = &dno->runs[dno->run_count++];
+    run->log_start = log_start;
+    run->log_count = log_count;
+    run->phys_start = phys_start;
     return FSW_SUCCESS;
 }
 
@@ -386,6 +682,16 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
     
     // Preconditions: The caller has checked that dno is a directory node.
     
+    // indexed directories are looked up through their hash tree
+    status = fsw_ext2_dx_lookup(vol, dno, lookup_name, child_dno_out);
+    if (status != FSW_UNSUPPORTED)
+        return status;
+    
+    // other large directories are looked up through an index built by the core
+    status = fsw_dnode_dir_index_lookup(dno, lookup_name, child_dno_out);
+    if (status != FSW_UNSUPPORTED)
+        return status;
+    
     entry_name.type = FSW_STRING_TYPE_ISO88591;
     
     // setup handle to read the directory
@@ -416,7 +722,7 @@ static fsw_status_t fsw_ext2_dir_lookup(struct fsw_ext2_volume *vol, struct fsw_
     }
     
     // setup a dnode for the child item
-    status = fsw_dnode_create(dno, child_ino, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
+    status = fsw_dnode_create(dno, child_ino, fsw_ext2_dentry_type(vol, &entry), &entry_name, child_dno_out);
     
 errorexit:
     fsw_shandle_close(&shand);
@@ -463,11 +769,39 @@ static fsw_status_t fsw_ext2_dir_read(struct fsw_ext2_volume *vol, struct fsw_ex
     entry_name.data = entry.name;
     
     // setup a dnode for the child item
-    status = fsw_dnode_create(dno, entry.inode, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
+    status = fsw_dnode_create(dno, entry.inode, fsw_ext2_dentry_type(vol, &entry), &entry_name, child_dno_out);
     
     return status;
 }
 
+/**
+ * Get the dnode type recorded in a directory entry. Volumes with the filetype
+ * feature store the type in each entry, which lets hosts list directories without
+ * reading the inodes. Returns FSW_DNODE_TYPE_UNKNOWN otherwise.
+ */
+
+static int fsw_ext2_dentry_type(struct fsw_ext2_volume *vol, struct ext2_dir_entry *entry)
+{
+    if (!(vol->sb->s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE))
+        return FSW_DNODE_TYPE_UNKNOWN;
+    
+    switch (entry->file_type) {
+        case EXT2_FT_REG_FILE:
+            return FSW_DNODE_TYPE_FILE;
+        case EXT2_FT_DIR:
+            return FSW_DNODE_TYPE_DIR;
+        case EXT2_FT_SYMLINK:
+            return FSW_DNODE_TYPE_SYMLINK;
+        case EXT2_FT_CHRDEV:
+        case EXT2_FT_BLKDEV:
+        case EXT2_FT_FIFO:
+        case EXT2_FT_SOCK:
+            return FSW_DNODE_TYPE_SPECIAL;
+        default:
+            return FSW_DNODE_TYPE_UNKNOWN;
+    }
+}
+
 /**
  * Read a directory entry from the directory's raw data. This internal function is used
  * to read a raw ext2 directory entry into memory. The shandle's position pointer is adjusted
@@ -518,6 +852,397 @@ static fsw_status_t fsw_ext2_read_dentry(struct fsw_shandle *shand, struct ext2_
     return FSW_SUCCESS;
 }
 
+/**
+ * Look up a name in a directory through its hash tree (htree). This internal function
+ * is used by fsw_ext2_dir_lookup for directories with the EXT2_INDEX_FL flag set. The
+ * name is hashed, the index blocks from the root down to the leaf level are searched
+ * for the hash, and only the leaf block found this way is scanned for the name. If the
+ * hash continues into the next leaf block (hash collisions), that block is scanned too.
+ *
+ * FSW_UNSUPPORTED is returned if the directory is not indexed or the index can't be
+ * used, the caller then scans the directory linearly.
+ */
+
+static fsw_status_t fsw_ext2_dx_lookup(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                       struct fsw_string *lookup_name, struct fsw_ext2_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    struct fsw_string name;
+    struct ext2_dx_root_info *info;
+    struct ext2_dx_entry *entries[EXT2_DX_MAX_LEVELS];
+    fsw_u64         node_bno[EXT2_DX_MAX_LEVELS];
+    fsw_u32         entry_count[EXT2_DX_MAX_LEVELS], entry_index[EXT2_DX_MAX_LEVELS];
+    void            *node_buffer[EXT2_DX_MAX_LEVELS];
+    fsw_u32         hash, next_hash, lo, hi, mid, log_bno;
+    int             hash_version, levels, level, i;
+    
+    if (vol->sb->s_rev_level != EXT2_DYNAMIC_REV ||
+        !(vol->sb->s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) ||
+        !(dno->raw->i_flags & EXT2_INDEX_FL))
+        return FSW_UNSUPPORTED;
+    // "." and ".." are not in the index
+    if (fsw_streq_cstr(lookup_name, ".") || fsw_streq_cstr(lookup_name, ".."))
+        return FSW_UNSUPPORTED;
+    
+    for (level = 0; level < EXT2_DX_MAX_LEVELS; level++)
+        node_buffer[level] = NULL;
+    
+    // read and check the root block
+    status = fsw_ext2_dx_block_get(vol, dno, 0, 1, &node_bno[0], &node_buffer[0]);
+    if (status)
+        return status;
+    info = (struct ext2_dx_root_info *)((fsw_u8 *)node_buffer[0] + EXT2_DX_ROOT_INFO_OFFSET);
+    hash_version = info->hash_version;
+    levels = info->indirect_levels + 1;
+    if (info->reserved_zero != 0 || info->info_length != 8 ||
+        hash_version > DX_HASH_TEA || levels > EXT2_DX_MAX_LEVELS) {
+        status = FSW_UNSUPPORTED;
+        goto errorexit;
+    }
+    if (vol->sb->s_flags & EXT2_FLAGS_UNSIGNED_HASH)
+        hash_version += DX_HASH_LEGACY_UNSIGNED;
+    
+    // hash the name in the on-disk encoding
+    status = fsw_strdup_coerce(&name, FSW_STRING_TYPE_ISO88591, lookup_name);
+    if (status)
+        goto errorexit;
+    hash = fsw_ext2_dx_hash(vol, hash_version, name.data, name.size);
+    fsw_strfree(&name);
+    
+    // walk down the index, pinning one block per level
+    for (level = 0; level < levels; level++) {
+        if (level > 0) {
+            status = fsw_ext2_dx_block_get(vol, dno, entries[level-1][entry_index[level-1]].block & EXT2_DX_BLOCK_MASK,
+                                           1, &node_bno[level], &node_buffer[level]);
+            if (status)
+                goto errorexit;
+        }
+        status = fsw_ext2_dx_node_entries(vol, node_buffer[level],
+                                          level == 0 ? EXT2_DX_ROOT_INFO_OFFSET + info->info_length
+                                                     : EXT2_DX_NODE_ENTRIES_OFFSET,
+                                          &entries[level], &entry_count[level]);
+        if (status)
+            goto errorexit;
+        
+        // binary search for the last entry with a hash at or below ours,
+        //  the first entry has no hash and covers everything below the second
+        lo = 0;
+        hi = entry_count[level];
+        while (hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if (entries[level][mid].hash <= hash)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        entry_index[level] = lo;
+    }
+    
+    while (1) {
+        // scan the leaf block
+        log_bno = entries[levels-1][entry_index[levels-1]].block & EXT2_DX_BLOCK_MASK;
+        status = fsw_ext2_dx_search_leaf(vol, dno, log_bno, lookup_name, child_dno_out);
+        if (status != FSW_NOT_FOUND)
+            break;
+        
+        // find the next leaf block; it is only relevant if its hash range starts
+        //  with our hash and the collision bit is set
+        for (level = levels - 1; level >= 0; level--)
+            if (entry_index[level] + 1 < entry_count[level])
+                break;
+        if (level < 0)
+            break;
+        next_hash = entries[level][entry_index[level] + 1].hash;
+        if ((next_hash & 1) == 0 || (next_hash & ~1) != hash)
+            break;
+        entry_index[level]++;
+        for (level++; level < levels; level++) {
+            fsw_block_release(vol, node_bno[level], node_buffer[level]);
+            node_buffer[level] = NULL;
+            status = fsw_ext2_dx_block_get(vol, dno, entries[level-1][entry_index[level-1]].block & EXT2_DX_BLOCK_MASK,
+                                           1, &node_bno[level], &node_buffer[level]);
+            if (status)
+                goto errorexit;
+            status = fsw_ext2_dx_node_entries(vol, node_buffer[level], EXT2_DX_NODE_ENTRIES_OFFSET,
+                                              &entries[level], &entry_count[level]);
+            if (status)
+                goto errorexit;
+            entry_index[level] = 0;
+        }
+    }
+    
+errorexit:
+    for (i = 0; i < EXT2_DX_MAX_LEVELS; i++)
+        if (node_buffer[i] != NULL)
+            fsw_block_release(vol, node_bno[i], node_buffer[i]);
+    return status;
+}
+
+/**
+ * Get a logical block of a directory from the block cache. This internal function
+ * is used by the htree code, which addresses directory blocks directly.
+ */
+
+static fsw_status_t fsw_ext2_dx_block_get(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                          fsw_u32 log_bno, fsw_u32 cache_level,
+                                          fsw_u64 *phys_bno_out, void **buffer_out)
+{
+    fsw_status_t    status;
+    struct fsw_extent extent;
+    
+    if ((fsw_u64)log_bno * vol->g.log_blocksize >= dno->g.size)
+        return FSW_VOLUME_CORRUPTED;
+    extent.log_start = log_bno;
+    status = fsw_ext2_get_extent(vol, dno, &extent);
+    if (status)
+        return status;
+    if (extent.type != FSW_EXTENT_TYPE_PHYSBLOCK)
+        return FSW_VOLUME_CORRUPTED;
+    
+    *phys_bno_out = extent.phys_start;
+    return fsw_block_get(vol, extent.phys_start, cache_level, buffer_out);
+}
+
+/**
+ * Locate and check the entries of an htree index block. The offset is where the
+ * count and limit fields are found within the block.
+ */
+
+static fsw_status_t fsw_ext2_dx_node_entries(struct fsw_ext2_volume *vol, void *buffer, fsw_u32 offset,
+                                             struct ext2_dx_entry **entries_out, fsw_u32 *count_out)
+{
+    struct ext2_dx_countlimit *countlimit;
+    
+    countlimit = (struct ext2_dx_countlimit *)((fsw_u8 *)buffer + offset);
+    if (countlimit->count == 0 || countlimit->count > countlimit->limit ||
+        countlimit->limit > (vol->g.log_blocksize - offset) / sizeof(struct ext2_dx_entry))
+        return FSW_VOLUME_CORRUPTED;
+    
+    *entries_out = (struct ext2_dx_entry *)countlimit;
+    *count_out = countlimit->count;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Scan one leaf block of an indexed directory for a name. If the name is found, a dnode
+ * is created for the entry. Returns FSW_NOT_FOUND if the name is not in the block.
+ */
+
+static fsw_status_t fsw_ext2_dx_search_leaf(struct fsw_ext2_volume *vol, struct fsw_ext2_dnode *dno,
+                                            fsw_u32 log_bno, struct fsw_string *lookup_name,
+                                            struct fsw_ext2_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    fsw_u64         phys_bno;
+    fsw_u32         offset;
+    void            *buffer;
+    struct ext2_dir_entry *entry;
+    struct fsw_string entry_name;
+    
+    status = fsw_ext2_dx_block_get(vol, dno, log_bno, 0, &phys_bno, &buffer);
+    if (status)
+        return status;
+    
+    entry_name.type = FSW_STRING_TYPE_ISO88591;
+    status = FSW_NOT_FOUND;
+    for (offset = 0; offset + 8 <= vol->g.log_blocksize; offset += entry->rec_len) {
+        entry = (struct ext2_dir_entry *)((fsw_u8 *)buffer + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > vol->g.log_blocksize ||
+            entry->rec_len < 8 + entry->name_len) {
+            status = FSW_VOLUME_CORRUPTED;
+            break;
+        }
+        if (entry->inode == 0)
+            continue;
+        
+        // compare name
+        entry_name.len = entry_name.size = entry->name_len;
+        entry_name.data = entry->name;
+        if (fsw_streq(lookup_name, &entry_name)) {
+            status = fsw_dnode_create(dno, entry->inode, fsw_ext2_dentry_type(vol, entry), &entry_name, child_dno_out);
+            break;
+        }
+    }
+    
+    fsw_block_release(vol, phys_bno, buffer);
+    return status;
+}
+
+/**
+ * Compute the htree hash of a name. This follows the directory hash functions of
+ * the Linux ext3 driver: the legacy hash, half MD4 and TEA, each in a signed and an
+ * unsigned char variant. Only the major hash is needed for lookups.
+ */
+
+static fsw_u32 fsw_ext2_dx_hash(struct fsw_ext2_volume *vol, int hash_version, fsw_u8 *name, int len)
+{
+    fsw_u32         hash, hash0, hash1, c;
+    fsw_u32         buf[4], in[8];
+    int             i, unsigned_chars;
+    
+    // use the seed from the superblock unless it is all zeros
+    buf[0] = 0x67452301;
+    buf[1] = 0xefcdab89;
+    buf[2] = 0x98badcfe;
+    buf[3] = 0x10325476;
+    for (i = 0; i < 4; i++) {
+        if (vol->sb->s_hash_seed[i] != 0) {
+            for (i = 0; i < 4; i++)
+                buf[i] = vol->sb->s_hash_seed[i];
+            break;
+        }
+    }
+    
+    unsigned_chars = (hash_version >= DX_HASH_LEGACY_UNSIGNED);
+    switch (hash_version) {
+        case DX_HASH_LEGACY:
+        case DX_HASH_LEGACY_UNSIGNED:
+            hash0 = 0x12a3fe2d;
+            hash1 = 0x37abe8f9;
+            for (i = 0; i < len; i++) {
+                c = unsigned_chars ? (fsw_u32)name[i] : (fsw_u32)(fsw_s32)(fsw_s8)name[i];
+                hash = hash1 + (hash0 ^ (c * 7152373));
+                if (hash & 0x80000000)
+                    hash -= 0x7fffffff;
+                hash1 = hash0;
+                hash0 = hash;
+            }
+            hash = hash0 << 1;
+            break;
+            
+        case DX_HASH_HALF_MD4:
+        case DX_HASH_HALF_MD4_UNSIGNED:
+            for (; len > 0; len -= 32, name += 32) {
+                fsw_ext2_dx_str2hashbuf(name, len, in, 8, unsigned_chars);
+                fsw_ext2_dx_half_md4(buf, in);
+            }
+            hash = buf[1];
+            break;
+            
+        case DX_HASH_TEA:
+        case DX_HASH_TEA_UNSIGNED:
+            for (; len > 0; len -= 16, name += 16) {
+                fsw_ext2_dx_str2hashbuf(name, len, in, 4, unsigned_chars);
+                fsw_ext2_dx_tea(buf, in);
+            }
+            hash = buf[0];
+            break;
+            
+        default:
+            hash = 0;
+            break;
+    }
+    
+    hash &= ~1;
+    if (hash == 0xfffffffe)     // reserved as end-of-directory marker
+        hash = 0xfffffffc;
+    return hash;
+}
+
+/**
+ * Pack up to num words of a name into the input buffer of the half MD4 and TEA hashes.
+ * Missing words are filled with a padding pattern derived from the name length.
+ */
+
+static void fsw_ext2_dx_str2hashbuf(fsw_u8 *name, int len, fsw_u32 *buf, int num, int unsigned_chars)
+{
+    fsw_u32         pad, val, c;
+    int             i;
+    
+    pad = (fsw_u32)len | ((fsw_u32)len << 8);
+    pad |= pad << 16;
+    
+    val = pad;
+    if (len > num * 4)
+        len = num * 4;
+    for (i = 0; i < len; i++) {
+        c = unsigned_chars ? (fsw_u32)name[i] : (fsw_u32)(fsw_s32)(fsw_s8)name[i];
+        val = c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0)
+        *buf++ = val;
+    while (--num >= 0)
+        *buf++ = pad;
+}
+
+#define DX_ROL32(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define DX_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define DX_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define DX_H(x, y, z) ((x) ^ (y) ^ (z))
+#define DX_ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + (x), a = DX_ROL32(a, s))
+#define DX_K2 0x5A827999UL
+#define DX_K3 0x6ED9EBA1UL
+
+/**
+ * Basic cut-down MD4 transform, as used for the half MD4 directory hash.
+ */
+
+static void fsw_ext2_dx_half_md4(fsw_u32 *buf, fsw_u32 *in)
+{
+    fsw_u32         a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+    
+    // round 1
+    DX_ROUND(DX_F, a, b, c, d, in[0],  3);
+    DX_ROUND(DX_F, d, a, b, c, in[1],  7);
+    DX_ROUND(DX_F, c, d, a, b, in[2], 11);
+    DX_ROUND(DX_F, b, c, d, a, in[3], 19);
+    DX_ROUND(DX_F, a, b, c, d, in[4],  3);
+    DX_ROUND(DX_F, d, a, b, c, in[5],  7);
+    DX_ROUND(DX_F, c, d, a, b, in[6], 11);
+    DX_ROUND(DX_F, b, c, d, a, in[7], 19);
+    
+    // round 2
+    DX_ROUND(DX_G, a, b, c, d, in[1] + DX_K2,  3);
+    DX_ROUND(DX_G, d, a, b, c, in[3] + DX_K2,  5);
+    DX_ROUND(DX_G, c, d, a, b, in[5] + DX_K2,  9);
+    DX_ROUND(DX_G, b, c, d, a, in[7] + DX_K2, 13);
+    DX_ROUND(DX_G, a, b, c, d, in[0] + DX_K2,  3);
+    DX_ROUND(DX_G, d, a, b, c, in[2] + DX_K2,  5);
+    DX_ROUND(DX_G, c, d, a, b, in[4] + DX_K2,  9);
+    DX_ROUND(DX_G, b, c, d, a, in[6] + DX_K2, 13);
+    
+    // round 3
+    DX_ROUND(DX_H, a, b, c, d, in[3] + DX_K3,  3);
+    DX_ROUND(DX_H, d, a, b, c, in[7] + DX_K3,  9);
+    DX_ROUND(DX_H, c, d, a, b, in[2] + DX_K3, 11);
+    DX_ROUND(DX_H, b, c, d, a, in[6] + DX_K3, 15);
+    DX_ROUND(DX_H, a, b, c, d, in[1] + DX_K3,  3);
+    DX_ROUND(DX_H, d, a, b, c, in[5] + DX_K3,  9);
+    DX_ROUND(DX_H, c, d, a, b, in[0] + DX_K3, 11);
+    DX_ROUND(DX_H, b, c, d, a, in[4] + DX_K3, 15);
+    
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+/**
+ * TEA transform, as used for the TEA directory hash.
+ */
+
+static void fsw_ext2_dx_tea(fsw_u32 *buf, fsw_u32 *in)
+{
+    fsw_u32         sum = 0;
+    fsw_u32         b0 = buf[0], b1 = buf[1];
+    fsw_u32         a = in[0], b = in[1], c = in[2], d = in[3];
+    int             n;
+    
+    for (n = 0; n < 16; n++) {
+        sum += 0x9E3779B9UL;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+    
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
 /**
  * Get the target path of a symbolic link. This function is called when a symbolic
  * link needs to be resolved. The core makes sure that the fsw_ext2_dnode_fill has been
@@ -539,7 +1264,11 @@ static fsw_status_t fsw_ext2_readlink(struct fsw_ext2_volume *vol, struct fsw_ex
     if (dno->g.size > FSW_PATH_MAX)
         return FSW_VOLUME_CORRUPTED;
     
-    ea_blocks = dno->raw->i_file_acl ? (vol->g.log_blocksize >> 9) : 0;
+    // i_blocks counts file system blocks instead of 512 byte sectors for huge files
+    if (dno->raw->i_flags & EXT4_HUGE_FILE_FL)
+        ea_blocks = dno->raw->i_file_acl ? 1 : 0;
+    else
+        ea_blocks = dno->raw->i_file_acl ? (vol->g.log_blocksize >> 9) : 0;
     
     if (dno->raw->i_blocks - ea_blocks == 0) {
         // "fast" symlink, path is stored inside the inode
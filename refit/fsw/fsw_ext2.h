@@ -45,10 +45,24 @@ struct fsw_ext2_volume {
     struct fsw_volume g;            //!< Generic volume structure
     
     struct ext2_super_block *sb;    //!< Full raw ext2 superblock structure
-    fsw_u32     *inotab_bno;        //!< Block numbers of the inode tables
+    fsw_u64     *inotab_bno;        //!< Block numbers of the inode tables, valid for groups whose descriptor block is loaded
+    fsw_u8      *gdesc_loaded;      //!< Bitmap of group descriptor blocks already read into inotab_bno
+    fsw_u32     group_count;        //!< Number of block groups
+    fsw_u32     gdesc_per_block;    //!< Number of group descriptors per block
     fsw_u32     ind_bcnt;           //!< Number of blocks addressable through an indirect block
     fsw_u32     dind_bcnt;          //!< Number of blocks addressable through a double-indirect block
     fsw_u32     inode_size;         //!< Size of inode structure in bytes
+    fsw_u32     desc_size;          //!< Size of a block group descriptor in bytes
+};
+
+/**
+ * ext2: Run of logical file blocks that are mapped to consecutive disk blocks.
+ */
+
+struct fsw_ext2_run {
+    fsw_u32     log_start;          //!< First logical block of the run
+    fsw_u32     log_count;          //!< Number of logical blocks in the run
+    fsw_u64     phys_start;         //!< First physical block of the run, or 0 for a sparse run
 };
 
 /**
@@ -59,6 +73,10 @@ struct fsw_ext2_dnode {
     struct fsw_dnode g;             //!< Generic dnode structure
     
     struct ext2_inode *raw;         //!< Full raw inode structure
+    
+    struct fsw_ext2_run *runs;      //!< Block map of the file, built on first use, or NULL
+    fsw_u32     run_count;          //!< Number of valid entries in runs
+    fsw_u32     run_capacity;       //!< Number of entries allocated for runs
 };
 
 
@@ -88,6 +88,41 @@ struct ext2_group_desc
     __le32  bg_reserved[3];
 };
 
+/*
+ * Structure of a blocks group descriptor with the 64bit feature. The first half
+ * matches struct ext2_group_desc.
+ */
+struct ext4_group_desc
+{
+    __le32  bg_block_bitmap;        /* Blocks bitmap block */
+    __le32  bg_inode_bitmap;        /* Inodes bitmap block */
+    __le32  bg_inode_table;         /* Inodes table block */
+    __le16  bg_free_blocks_count;   /* Free blocks count */
+    __le16  bg_free_inodes_count;   /* Free inodes count */
+    __le16  bg_used_dirs_count;     /* Directories count */
+    __le16  bg_flags;               /* EXT4_BG_flags (INODE_UNINIT, etc) */
+    __le32  bg_exclude_bitmap_lo;   /* Exclude bitmap for snapshots */
+    __le16  bg_block_bitmap_csum_lo;/* crc32c(s_uuid+grp_num+bbitmap) LE */
+    __le16  bg_inode_bitmap_csum_lo;/* crc32c(s_uuid+grp_num+ibitmap) LE */
+    __le16  bg_itable_unused;       /* Unused inodes count */
+    __le16  bg_checksum;            /* crc16(sb_uuid+group+desc) */
+    __le32  bg_block_bitmap_hi;     /* Blocks bitmap block MSB */
+    __le32  bg_inode_bitmap_hi;     /* Inodes bitmap block MSB */
+    __le32  bg_inode_table_hi;      /* Inodes table block MSB */
+    __le16  bg_free_blocks_count_hi;/* Free blocks count MSB */
+    __le16  bg_free_inodes_count_hi;/* Free inodes count MSB */
+    __le16  bg_used_dirs_count_hi;  /* Directories count MSB */
+    __le16  bg_itable_unused_hi;    /* Unused inodes count MSB */
+    __le32  bg_exclude_bitmap_hi;   /* Exclude bitmap block MSB */
+    __le16  bg_block_bitmap_csum_hi;/* crc32c(s_uuid+grp_num+bbitmap) BE */
+    __le16  bg_inode_bitmap_csum_hi;/* crc32c(s_uuid+grp_num+ibitmap) BE */
+    __u32   bg_reserved;
+};
+
+#define EXT2_MIN_DESC_SIZE              32
+#define EXT4_MIN_DESC_SIZE_64BIT        64
+#define EXT4_MAX_DESC_SIZE              EXT2_MIN_BLOCK_SIZE
+
 /*
  * Macro-instructions used to manage group descriptors
  */
@@ -128,6 +163,8 @@ struct ext2_group_desc
 #define EXT2_NOTAIL_FL                  0x00008000 /* file tail should not be merged */
 #define EXT2_DIRSYNC_FL                 0x00010000 /* dirsync behaviour (directories only) */
 #define EXT2_TOPDIR_FL                  0x00020000 /* Top of directory hierarchies*/
+#define EXT4_HUGE_FILE_FL               0x00040000 /* Set to each huge file */
+#define EXT4_EXTENTS_FL                 0x00080000 /* Inode uses extents */
 #define EXT2_RESERVED_FL                0x80000000 /* reserved for ext2 lib */
 
 #define EXT2_FL_USER_VISIBLE            0x0003DFFF /* User visible flags */
@@ -260,13 +297,27 @@ struct ext2_super_block {
     __u32   s_last_orphan;          /* start of list of inodes to delete */
     __u32   s_hash_seed[4];         /* HTREE hash seed */
     __u8    s_def_hash_version;     /* Default hash version to use */
-    __u8    s_reserved_char_pad;
-    __u16   s_reserved_word_pad;
+    __u8    s_jnl_backup_type;
+    __le16  s_desc_size;            /* size of group descriptor */
     __le32  s_default_mount_opts;
     __le32  s_first_meta_bg;        /* First metablock block group */
-    __u32   s_reserved[190];        /* Padding to the end of the block */
+    __le32  s_mkfs_time;            /* When the filesystem was created */
+    __le32  s_jnl_blocks[17];       /* Backup of the journal inode */
+    __le32  s_blocks_count_hi;      /* Blocks count, high 32 bits */
+    __le32  s_r_blocks_count_hi;    /* Reserved blocks count, high 32 bits */
+    __le32  s_free_blocks_count_hi; /* Free blocks count, high 32 bits */
+    __le16  s_min_extra_isize;      /* All inodes have at least # bytes */
+    __le16  s_want_extra_isize;     /* New inodes should reserve # bytes */
+    __le32  s_flags;                /* Miscellaneous flags */
+    __u32   s_reserved[167];        /* Padding to the end of the block */
 };
 
+/*
+ * Miscellaneous superblock flags
+ */
+#define EXT2_FLAGS_SIGNED_HASH          0x0001  /* Signed dirhash in use */
+#define EXT2_FLAGS_UNSIGNED_HASH        0x0002  /* Unsigned dirhash in use */
+
 /*
  * Revision levels
  */
@@ -312,6 +363,10 @@ struct ext2_super_block {
 #define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER     0x0001
 #define EXT2_FEATURE_RO_COMPAT_LARGE_FILE       0x0002
 #define EXT2_FEATURE_RO_COMPAT_BTREE_DIR        0x0004
+#define EXT4_FEATURE_RO_COMPAT_HUGE_FILE        0x0008
+#define EXT4_FEATURE_RO_COMPAT_GDT_CSUM         0x0010
+#define EXT4_FEATURE_RO_COMPAT_DIR_NLINK        0x0020
+#define EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE      0x0040
 #define EXT2_FEATURE_RO_COMPAT_ANY              0xffffffff
 
 #define EXT2_FEATURE_INCOMPAT_COMPRESSION       0x0001
@@ -319,6 +374,10 @@ struct ext2_super_block {
 #define EXT3_FEATURE_INCOMPAT_RECOVER           0x0004
 #define EXT3_FEATURE_INCOMPAT_JOURNAL_DEV       0x0008
 #define EXT2_FEATURE_INCOMPAT_META_BG           0x0010
+#define EXT3_FEATURE_INCOMPAT_EXTENTS           0x0040 /* extents support */
+#define EXT4_FEATURE_INCOMPAT_64BIT             0x0080
+#define EXT4_FEATURE_INCOMPAT_MMP               0x0100
+#define EXT4_FEATURE_INCOMPAT_FLEX_BG           0x0200
 #define EXT2_FEATURE_INCOMPAT_ANY               0xffffffff
 
 /*
@@ -332,6 +391,37 @@ struct ext2_super_block {
 #define EXT2_FEATURE_INCOMPAT_UNSUPPORTED       ~EXT2_FEATURE_INCOMPAT_SUPP
 */
 
+/*
+ * Structures of the ext4 extent tree. Inodes with EXT4_EXTENTS_FL keep the root
+ * node in i_block, further nodes fill whole blocks. Each node starts with a header,
+ * followed by index entries (eh_depth > 0) or by extents (eh_depth == 0).
+ */
+struct ext4_extent_header {
+    __le16  eh_magic;               /* probably will support different formats */
+    __le16  eh_entries;             /* number of valid entries */
+    __le16  eh_max;                 /* capacity of store in entries */
+    __le16  eh_depth;               /* has tree real underlying blocks? */
+    __le32  eh_generation;          /* generation of the tree */
+};
+
+struct ext4_extent_idx {
+    __le32  ei_block;               /* index covers logical blocks from 'block' */
+    __le32  ei_leaf_lo;             /* pointer to the physical block of the next level */
+    __le16  ei_leaf_hi;             /* high 16 bits of physical block */
+    __u16   ei_unused;
+};
+
+struct ext4_extent {
+    __le32  ee_block;               /* first logical block extent covers */
+    __le16  ee_len;                 /* number of blocks covered by extent */
+    __le16  ee_start_hi;            /* high 16 bits of physical block */
+    __le32  ee_start_lo;            /* low 32 bits of physical block */
+};
+
+#define EXT4_EXT_MAGIC                  0xf30a
+#define EXT4_EXT_INIT_MAX_LEN           (1UL << 15)     /* longer extents are uninitialized */
+#define EXT4_EXT_MAX_DEPTH              5
+
 /*
  * Structure of a directory entry
  */
@@ -347,6 +437,48 @@ struct ext2_dir_entry {
 // NOTE: The original Linux kernel header defines ext2_dir_entry with the original
 //  layout and ext2_dir_entry_2 with the revised layout. We simply use the revised one.
 
+/*
+ * Structures of the hashed directory index (htree). The root block of an indexed
+ * directory starts with regular "." and ".." entries, the latter spanning the rest
+ * of the block. Interior index blocks start with an empty entry spanning the block.
+ */
+
+struct ext2_dx_root_info {
+    __le32  reserved_zero;
+    __u8    hash_version;           /* 0 now, 1 at release */
+    __u8    info_length;            /* 8 */
+    __u8    indirect_levels;
+    __u8    unused_flags;
+};
+
+struct ext2_dx_entry {
+    __le32  hash;
+    __le32  block;
+};
+
+// NOTE: The count and limit fields overlay the hash field of the first entry
+//  of every index block.
+struct ext2_dx_countlimit {
+    __le16  limit;
+    __le16  count;
+};
+
+#define EXT2_DX_ROOT_INFO_OFFSET        24  /* after the "." and ".." entries */
+#define EXT2_DX_NODE_ENTRIES_OFFSET     8   /* after the empty dir_entry header */
+#define EXT2_DX_MAX_LEVELS              3   /* root plus at most two index levels */
+#define EXT2_DX_BLOCK_MASK              0x0fffffff
+
+/*
+ * Directory hash versions. The unsigned variants are selected through
+ * EXT2_FLAGS_UNSIGNED_HASH in the superblock, they are not stored on disk.
+ */
+#define DX_HASH_LEGACY                  0
+#define DX_HASH_HALF_MD4                1
+#define DX_HASH_TEA                     2
+#define DX_HASH_LEGACY_UNSIGNED         3
+#define DX_HASH_HALF_MD4_UNSIGNED       4
+#define DX_HASH_TEA_UNSIGNED            5
+
 /*
  * Ext2 directory file types.  Only the low 3 bits are used.  The
  * other bits are reserved for now.
@@ -3,10 +3,9 @@
  * ISO9660 file system driver code.
  *
  * Current limitations:
- *  - Files must be in one extent (i.e. Level 2)
- *  - No Joliet or Rock Ridge extensions
+ *  - Multi-extent files must use whole sectors in all but their last extent
+ *  - Rock Ridge support covers names (NM), Posix modes (PX) and symlinks (SL) only
  *  - No interleaving
- *  - inode number generation strategy fails on volumes > 2 GB
  *  - No blocksizes != 2048
  *  - No High Sierra or anything else != 'CD001'
  *  - No volume sets with directories pointing at other volumes
@@ -65,7 +64,16 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
                                            struct fsw_string *lookup_name, struct fsw_iso9660_dnode **child_dno);
 static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                          struct fsw_shandle *shand, struct fsw_iso9660_dnode **child_dno);
-static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_shandle *shand, struct iso9660_dirrec_buffer *dirrec_buffer);
+static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
+                                            fsw_u64 *pos, struct iso9660_dirrec_buffer *dirrec_buffer);
+static void         fsw_iso9660_release_dirrec(struct fsw_iso9660_volume *vol,
+                                               struct iso9660_dirrec_buffer *dirrec_buffer);
+static fsw_status_t fsw_iso9660_susp_parse(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec,
+                                           struct iso9660_dirrec_buffer *dirrec_buffer,
+                                           fsw_u8 *link, fsw_u32 *link_size);
+static fsw_status_t fsw_iso9660_link_append(fsw_u8 *link, fsw_u32 *link_size, const void *data, fsw_u32 len);
+static fsw_status_t fsw_iso9660_detect_rr(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *root_dirrec);
+static fsw_status_t fsw_iso9660_read_extents(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno);
 
 static fsw_status_t fsw_iso9660_readlink(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                          struct fsw_string *link);
@@ -89,6 +97,8 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(iso9660) = {
     fsw_iso9660_dir_lookup,
     fsw_iso9660_dir_read,
     fsw_iso9660_readlink,
+    NULL,
+    NULL,
 };
 
 /**
@@ -102,7 +112,7 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
     void            *buffer;
     fsw_u32         blockno;
     struct iso9660_volume_descriptor *voldesc;
-    struct iso9660_primary_volume_descriptor *pvoldesc;
+    struct iso9660_primary_volume_descriptor *pvoldesc, *svoldesc;
     fsw_u32         voldesc_type;
     int             i;
     struct fsw_string s;
@@ -120,22 +130,31 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
         voldesc_type = voldesc->volume_descriptor_type;
         if (fsw_memeq(voldesc->standard_identifier, "CD001", 5)) {
             // descriptor follows ISO 9660 standard
-            if (voldesc_type == 1 && voldesc->volume_descriptor_version == 1) {
+            if (voldesc_type == ISO9660_VD_PRIMARY && voldesc->volume_descriptor_version == 1) {
                 // suitable Primary Volume Descriptor found
                 if (vol->primary_voldesc) {
                     fsw_free(vol->primary_voldesc);
                     vol->primary_voldesc = NULL;
                 }
                 status = fsw_memdup((void **)&vol->primary_voldesc, voldesc, ISO9660_BLOCKSIZE);
+            } else if (voldesc_type == ISO9660_VD_SUPPLEMENTARY && !vol->joliet) {
+                // Joliet is marked by the UCS-2 escape sequence of a Supplementary Volume Descriptor
+                svoldesc = (struct iso9660_primary_volume_descriptor *)buffer;
+                if (svoldesc->escape_sequences[0] == '%' && svoldesc->escape_sequences[1] == '/' &&
+                    (svoldesc->escape_sequences[2] == '@' || svoldesc->escape_sequences[2] == 'C' ||
+                     svoldesc->escape_sequences[2] == 'E')) {
+                    fsw_memcpy(&vol->joliet_root, &svoldesc->root_directory, sizeof(struct iso9660_dirrec));
+                    vol->joliet = 1;
+                }
             }
         } else if (!fsw_memeq(voldesc->standard_identifier, "CD", 2)) {
             // completely alien standard identifier, stop reading
-            voldesc_type = 255;
+            voldesc_type = ISO9660_VD_TERMINATOR;
         }
         
         fsw_block_release(vol, blockno, buffer);
         blockno++;
-    } while (!status && voldesc_type != 255);
+    } while (!status && voldesc_type != ISO9660_VD_TERMINATOR);
     if (status)
         return status;
     
@@ -157,11 +176,25 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
     if (status)
         return status;
     
+    // Rock Ridge names in the primary tree are preferred over Joliet names
+    status = fsw_iso9660_detect_rr(vol, &pvoldesc->root_directory);
+    if (status)
+        return status;
+    if (vol->rock_ridge)
+        vol->joliet = 0;
+    
+    // hosts like EFI look up names without regard to case; since exact matches are
+    //  preferred, Rock Ridge names that differ only in case still resolve correctly
+    vol->g.case_insensitive = 1;
+    
     // setup the root dnode
     status = fsw_dnode_create_root(vol, ISO9660_SUPERBLOCK_BLOCKNO << ISO9660_BLOCKSIZE_BITS, &vol->g.root);
     if (status)
         return status;
-    fsw_memcpy(&vol->g.root->dirrec, &pvoldesc->root_directory, sizeof(struct iso9660_dirrec));
+    if (vol->joliet)
+        fsw_memcpy(&vol->g.root->dirrec, &vol->joliet_root, sizeof(struct iso9660_dirrec));
+    else
+        fsw_memcpy(&vol->g.root->dirrec, &pvoldesc->root_directory, sizeof(struct iso9660_dirrec));
     
     // release volume descriptors
     fsw_free(vol->primary_voldesc);
@@ -172,6 +205,36 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
     return FSW_SUCCESS;
 }
 
+/**
+ * Check whether the volume uses Rock Ridge. The System Use area of the first record
+ * of the root directory (".") starts with a SUSP "SP" entry in that case, which also
+ * gives the number of bytes to skip in the System Use areas of all records.
+ */
+
+static fsw_status_t fsw_iso9660_detect_rr(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *root_dirrec)
+{
+    fsw_status_t    status;
+    fsw_u32         blockno;
+    fsw_u8          *buffer, *sp;
+    struct iso9660_dirrec *dirrec;
+    
+    blockno = ISOINT(root_dirrec->extent_location);
+    status = fsw_block_get(vol, blockno, 1, (void **)&buffer);
+    if (status)
+        return status;
+    
+    dirrec = (struct iso9660_dirrec *)buffer;
+    sp = buffer + 34;   // the name of "." is one byte long, so there is no padding
+    if (dirrec->dirrec_length >= 34 + 7 && dirrec->file_identifier_length == 1 &&
+        sp[0] == 'S' && sp[1] == 'P' && sp[2] >= 7 && sp[4] == 0xbe && sp[5] == 0xef) {
+        vol->rock_ridge = 1;
+        vol->susp_skip = sp[6];
+    }
+    
+    fsw_block_release(vol, blockno, buffer);
+    return FSW_SUCCESS;
+}
+
 /**
  * Free the volume data structure. Called by the core after an unmount or after
  * an unsuccessful mount to release the memory used by the file system type specific
@@ -205,13 +268,107 @@ static fsw_status_t fsw_iso9660_volume_stat(struct fsw_iso9660_volume *vol, stru
 
 static fsw_status_t fsw_iso9660_dnode_fill(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
 {
+    if (dno->extents != NULL)
+        return FSW_SUCCESS;     // already filled, including the extent list
+    
     // get info from the directory record
     dno->g.size = ISOINT(dno->dirrec.data_length);
-    if (dno->dirrec.file_flags & 0x02)
+    if (S_ISLNK(dno->mode))
+        dno->g.type = FSW_DNODE_TYPE_SYMLINK;
+    else if (dno->dirrec.file_flags & ISO9660_FILE_FLAG_DIRECTORY)
         dno->g.type = FSW_DNODE_TYPE_DIR;
     else
         dno->g.type = FSW_DNODE_TYPE_FILE;
     
+    // the data of a multi-extent file is spread over several directory records
+    if ((dno->dirrec.file_flags & ISO9660_FILE_FLAG_MULTI_EXTENT) && dno->g.parent != NULL)
+        return fsw_iso9660_read_extents(vol, dno);
+    
+    return FSW_SUCCESS;
+}
+
+/**
+ * Collect the extents of a multi-extent file. The file's directory record is followed
+ * by further records with the same name, one for each extent, and all but the last carry
+ * the multi-extent flag. They are read again from the parent directory, starting at the
+ * record that the dnode ID points to. Extents that follow each other on disk are merged,
+ * so that files written contiguously map to a single large run. The file size is the sum
+ * of the extent sizes and may exceed 4 GiB.
+ */
+
+static fsw_status_t fsw_iso9660_read_extents(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
+{
+    fsw_status_t    status;
+    struct fsw_iso9660_dnode *parent = dno->g.parent;
+    struct fsw_iso9660_extent *extents, *new_extents;
+    fsw_u32         count, capacity, location, sector_count, data_length;
+    fsw_u64         pos, size;
+    struct iso9660_dirrec_buffer dirrec_buffer;
+    struct iso9660_dirrec *dirrec;
+    
+    pos = dno->g.dnode_id - ((fsw_u64)ISOINT(parent->dirrec.extent_location) << ISO9660_BLOCKSIZE_BITS);
+    dirrec_buffer.buffer = NULL;
+    extents = NULL;
+    count = capacity = 0;
+    size = 0;
+    while (1) {
+        status = fsw_iso9660_read_dirrec(vol, parent, &pos, &dirrec_buffer);
+        if (status)
+            break;
+        dirrec = dirrec_buffer.dirrec;
+        if (dirrec == NULL) {
+            status = FSW_VOLUME_CORRUPTED;  // the directory ends before the last extent
+            break;
+        }
+        
+        // extents are mapped back to back, so all but the last must fill whole sectors
+        if (size & (ISO9660_BLOCKSIZE-1)) {
+            status = FSW_UNSUPPORTED;
+            break;
+        }
+        location = ISOINT(dirrec->extent_location);
+        data_length = ISOINT(dirrec->data_length);
+        sector_count = (data_length + (ISO9660_BLOCKSIZE-1)) >> ISO9660_BLOCKSIZE_BITS;
+        size += data_length;
+        
+        if (sector_count > 0) {
+            if (count > 0 && extents[count-1].phys_start + extents[count-1].count == location) {
+                extents[count-1].count += sector_count;
+            } else {
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 4;
+                    status = fsw_alloc(capacity * sizeof(struct fsw_iso9660_extent), &new_extents);
+                    if (status)
+                        break;
+                    if (extents != NULL) {
+                        fsw_memcpy(new_extents, extents, count * sizeof(struct fsw_iso9660_extent));
+                        fsw_free(extents);
+                    }
+                    extents = new_extents;
+                }
+                extents[count].phys_start = location;
+                extents[count].count = sector_count;
+                count++;
+            }
+        }
+        
+        if (!(dirrec->file_flags & ISO9660_FILE_FLAG_MULTI_EXTENT))
+            break;
+    }
+    fsw_iso9660_release_dirrec(vol, &dirrec_buffer);
+    
+    if (status == FSW_SUCCESS && count == 0)
+        status = fsw_alloc_zero(sizeof(struct fsw_iso9660_extent), (void **)&extents);  // all extents empty
+    if (status) {
+        if (extents != NULL)
+            fsw_free(extents);
+        return status;
+    }
+    
+    dno->extents = extents;
+    dno->extent_count = count;
+    dno->g.size = size;
+    fsw_dnode_account(dno, 0, (capacity ? capacity : 1) * sizeof(struct fsw_iso9660_extent));
     return FSW_SUCCESS;
 }
 
@@ -223,6 +380,8 @@ static fsw_status_t fsw_iso9660_dnode_fill(struct fsw_iso9660_volume *vol, struc
 
 static void fsw_iso9660_dnode_free(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
 {
+    if (dno->extents != NULL)
+        fsw_free(dno->extents);
 }
 
 /**
@@ -236,6 +395,8 @@ static fsw_status_t fsw_iso9660_dnode_stat(struct fsw_iso9660_volume *vol, struc
                                            struct fsw_dnode_stat *sb)
 {
     sb->used_bytes = (dno->g.size + (ISO9660_BLOCKSIZE-1)) & ~(ISO9660_BLOCKSIZE-1);
+    if (dno->mode)
+        sb->store_attr_posix(sb, dno->mode);
     /*
     sb->store_time_posix(sb, FSW_DNODE_STAT_CTIME, dno->raw->i_ctime);
     sb->store_time_posix(sb, FSW_DNODE_STAT_ATIME, dno->raw->i_atime);
@@ -257,15 +418,32 @@ static fsw_status_t fsw_iso9660_dnode_stat(struct fsw_iso9660_volume *vol, struc
 static fsw_status_t fsw_iso9660_get_extent(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                            struct fsw_extent *extent)
 {
+    fsw_u32         i, log_start;
+    
     // Preconditions: The caller has checked that the requested logical block
     //  is within the file's size. The dnode has complete information, i.e.
-    //  fsw_iso9660_dnode_read_info was called successfully on it.
+    //  fsw_iso9660_dnode_fill was called successfully on it.
     
     extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
-    extent->phys_start = ISOINT(dno->dirrec.extent_location);
-    extent->log_start = 0;
-    extent->log_count = (ISOINT(dno->dirrec.data_length) + (ISO9660_BLOCKSIZE-1)) >> ISO9660_BLOCKSIZE_BITS;
-    return FSW_SUCCESS;
+    if (dno->extents == NULL) {
+        extent->phys_start = ISOINT(dno->dirrec.extent_location);
+        extent->log_start = 0;
+        extent->log_count = (ISOINT(dno->dirrec.data_length) + (ISO9660_BLOCKSIZE-1)) >> ISO9660_BLOCKSIZE_BITS;
+        return FSW_SUCCESS;
+    }
+    
+    // multi-extent file: each run of sectors is one extent
+    log_start = 0;
+    for (i = 0; i < dno->extent_count; i++) {
+        if (extent->log_start - log_start < dno->extents[i].count) {
+            extent->phys_start = dno->extents[i].phys_start;
+            extent->log_start = log_start;
+            extent->log_count = dno->extents[i].count;
+            return FSW_SUCCESS;
+        }
+        log_start += dno->extents[i].count;
+    }
+    return FSW_VOLUME_CORRUPTED;
 }
 
 /**
@@ -279,46 +457,78 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
                                            struct fsw_string *lookup_name, struct fsw_iso9660_dnode **child_dno_out)
 {
     fsw_status_t    status;
-    struct fsw_shandle shand;
+    fsw_u64         pos, pos_nocase;
+    int             in_multi_extent;
     struct iso9660_dirrec_buffer dirrec_buffer;
-    struct iso9660_dirrec *dirrec = &dirrec_buffer.dirrec;
+    struct iso9660_dirrec *dirrec;
     
     // Preconditions: The caller has checked that dno is a directory node.
     
-    // setup handle to read the directory
-    status = fsw_shandle_open(dno, &shand);
-    if (status)
+    // large directories are looked up through an index built by the core
+    status = fsw_dnode_dir_index_lookup(dno, lookup_name, child_dno_out);
+    if (status != FSW_UNSUPPORTED)
         return status;
     
-    // scan the directory for the file
+    // scan the directory for the file, comparing the names in the sector buffers;
+    //  an exact match wins, otherwise the first entry that differs only in case
+    dirrec_buffer.buffer = NULL;
+    pos = 0;
+    pos_nocase = ISO9660_NO_POS;
+    in_multi_extent = 0;
     while (1) {
         // read next entry
-        status = fsw_iso9660_read_dirrec(&shand, &dirrec_buffer);
+        status = fsw_iso9660_read_dirrec(vol, dno, &pos, &dirrec_buffer);
         if (status)
             goto errorexit;
-        if (dirrec->dirrec_length == 0) {
+        dirrec = dirrec_buffer.dirrec;
+        if (dirrec == NULL) {
             // end of directory reached
-            status = FSW_NOT_FOUND;
-            goto errorexit;
+            if (pos_nocase == ISO9660_NO_POS) {
+                status = FSW_NOT_FOUND;
+                goto errorexit;
+            }
+            
+            // go back to the case-insensitive match
+            pos = pos_nocase;
+            status = fsw_iso9660_read_dirrec(vol, dno, &pos, &dirrec_buffer);
+            if (status)
+                goto errorexit;
+            dirrec = dirrec_buffer.dirrec;
+            if (dirrec == NULL) {
+                status = FSW_VOLUME_CORRUPTED;
+                goto errorexit;
+            }
+            break;
         }
         
+        // skip the further records of a multi-extent file
+        if (in_multi_extent) {
+            in_multi_extent = dirrec->file_flags & ISO9660_FILE_FLAG_MULTI_EXTENT;
+            continue;
+        }
+        in_multi_extent = dirrec->file_flags & ISO9660_FILE_FLAG_MULTI_EXTENT;
+        
         // skip . and ..
         if (dirrec->file_identifier_length == 1 &&
             (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1))
             continue;
         
         // compare name
-        if (fsw_streq(lookup_name, &dirrec_buffer.name))  // TODO: compare case-insensitively
+        if (fsw_streq(lookup_name, &dirrec_buffer.name))
             break;
+        if (pos_nocase == ISO9660_NO_POS && fsw_streq_nocase(lookup_name, &dirrec_buffer.name))
+            pos_nocase = pos - dirrec->dirrec_length;
     }
     
     // setup a dnode for the child item
-    status = fsw_dnode_create(dno, dirrec_buffer.ino, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
-    if (status == FSW_SUCCESS)
+    status = fsw_dnode_create(dno, dirrec_buffer.dirrec_pos, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
+    if (status == FSW_SUCCESS) {
         fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+        (*child_dno_out)->mode = dirrec_buffer.mode;
+    }
     
 errorexit:
-    fsw_shandle_close(&shand);
+    fsw_iso9660_release_dirrec(vol, &dirrec_buffer);
     return status;
 }
 
@@ -335,19 +545,23 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
 {
     fsw_status_t    status;
     struct iso9660_dirrec_buffer dirrec_buffer;
-    struct iso9660_dirrec *dirrec = &dirrec_buffer.dirrec;
+    struct iso9660_dirrec *dirrec;
     
     // Preconditions: The caller has checked that dno is a directory node. The caller
     //  has opened a storage handle to the directory's storage and keeps it around between
     //  calls.
     
+    dirrec_buffer.buffer = NULL;
     while (1) {
         // read next entry
-        status = fsw_iso9660_read_dirrec(shand, &dirrec_buffer);
+        status = fsw_iso9660_read_dirrec(vol, dno, &shand->pos, &dirrec_buffer);
         if (status)
-            return status;
-        if (dirrec->dirrec_length == 0)   // end of directory
-            return FSW_NOT_FOUND;
+            goto errorexit;
+        dirrec = dirrec_buffer.dirrec;
+        if (dirrec == NULL) {   // end of directory
+            status = FSW_NOT_FOUND;
+            goto errorexit;
+        }
         
         // skip . and ..
         if (dirrec->file_identifier_length == 1 &&
@@ -357,52 +571,108 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
     }
     
     // setup a dnode for the child item
-    status = fsw_dnode_create(dno, dirrec_buffer.ino, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
-    if (status == FSW_SUCCESS)
-        fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+    status = fsw_dnode_create(dno, dirrec_buffer.dirrec_pos, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
+    if (status)
+        goto errorexit;
+    fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+    (*child_dno_out)->mode = dirrec_buffer.mode;
+    
+    // the further records of a multi-extent file belong to the same dnode, skip them
+    while (dirrec->file_flags & ISO9660_FILE_FLAG_MULTI_EXTENT) {
+        status = fsw_iso9660_read_dirrec(vol, dno, &shand->pos, &dirrec_buffer);
+        if (status) {
+            fsw_dnode_release((struct fsw_dnode *)*child_dno_out);
+            goto errorexit;
+        }
+        dirrec = dirrec_buffer.dirrec;
+        if (dirrec == NULL)
+            break;  // reported by fsw_iso9660_read_extents when the file is used
+    }
     
+errorexit:
+    fsw_iso9660_release_dirrec(vol, &dirrec_buffer);
     return status;
 }
 
 /**
- * Read a directory entry from the directory's raw data. This internal function is used
- * to read a raw iso9660 directory entry into memory. The shandle's position pointer is adjusted
- * to point to the next entry.
+ * Get the next directory record from a directory's data. This internal function parses
+ * the records in place: the directory sector holding the record at *pos is fetched from
+ * the block cache and kept in dirrec_buffer, so that walking a sector's records costs no
+ * further block lookups or copies. The caller must set dirrec_buffer->buffer to NULL
+ * before the first call and call fsw_iso9660_release_dirrec when done.
+ *
+ * Records never cross sector boundaries. A zero length byte means that the rest of the
+ * sector is padding, and the next record starts at the beginning of the next sector. On
+ * return, *pos points to the record following the one returned. At the end of the
+ * directory, dirrec_buffer->dirrec is set to NULL.
  */
 
-static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_shandle *shand, struct iso9660_dirrec_buffer *dirrec_buffer)
+static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
+                                            fsw_u64 *pos, struct iso9660_dirrec_buffer *dirrec_buffer)
 {
     fsw_status_t    status;
-    fsw_u32         buffer_size, remaining_size, name_len;
-    int             i;
-    struct iso9660_dirrec *dirrec = &dirrec_buffer->dirrec;
+    fsw_u32         phys_bno, offset;
+    int             i, name_len;
+    fsw_u8          *name;
+    struct iso9660_dirrec *dirrec;
     
-    dirrec_buffer->ino = (ISOINT(((struct fsw_iso9660_dnode *)shand->dnode)->dirrec.extent_location)
-                          << ISO9660_BLOCKSIZE_BITS)
-        + (fsw_u32)shand->pos;
-    
-    // read fixed size part of directory record
-    buffer_size = 33;
-    status = fsw_shandle_read(shand, &buffer_size, dirrec);
-    if (status)
-        return status;
-    
-    if (buffer_size < 33 || dirrec->dirrec_length == 0) {
-        // end of directory reached
-        dirrec->dirrec_length = 0;
-        return FSW_SUCCESS;
+    dirrec_buffer->dirrec = NULL;
+    while (1) {
+        if (*pos >= dno->g.size)
+            return FSW_SUCCESS;     // end of directory reached
+        
+        // get the sector holding the record
+        phys_bno = ISOINT(dno->dirrec.extent_location) + (fsw_u32)(*pos >> ISO9660_BLOCKSIZE_BITS);
+        offset = (fsw_u32)*pos & (ISO9660_BLOCKSIZE-1);
+        if (dirrec_buffer->buffer != NULL && dirrec_buffer->phys_bno != phys_bno)
+            fsw_iso9660_release_dirrec(vol, dirrec_buffer);
+        if (dirrec_buffer->buffer == NULL) {
+            status = fsw_block_get(vol, phys_bno, 1, (void **)&dirrec_buffer->buffer);
+            if (status) {
+                dirrec_buffer->buffer = NULL;
+                return status;
+            }
+            dirrec_buffer->phys_bno = phys_bno;
+        }
+        
+        dirrec = (struct iso9660_dirrec *)(dirrec_buffer->buffer + offset);
+        if (dirrec->dirrec_length == 0) {
+            // padding up to the end of the sector
+            *pos = (*pos | (ISO9660_BLOCKSIZE-1)) + 1;
+            continue;
+        }
+        break;
     }
-    if (dirrec->dirrec_length < 33 ||
+    
+    if (dirrec->dirrec_length < 33 || offset + dirrec->dirrec_length > ISO9660_BLOCKSIZE ||
         dirrec->dirrec_length < 33 + dirrec->file_identifier_length)
         return FSW_VOLUME_CORRUPTED;
     
-    // read variable size part of directory record
-    buffer_size = remaining_size = dirrec->dirrec_length - 33;
-    status = fsw_shandle_read(shand, &buffer_size, dirrec->file_identifier);
-    if (status)
-        return status;
-    if (buffer_size < remaining_size)
-        return FSW_VOLUME_CORRUPTED;
+    dirrec_buffer->dirrec_pos = ((fsw_u64)ISOINT(dno->dirrec.extent_location) << ISO9660_BLOCKSIZE_BITS)
+        + *pos;
+    dirrec_buffer->dirrec = dirrec;
+    *pos += dirrec->dirrec_length;
+    
+    if (vol->joliet) {
+        // Joliet names are UCS-2 big endian; copy them so the characters are aligned
+        name_len = dirrec->file_identifier_length & ~1;
+        name = (fsw_u8 *)dirrec_buffer->name_buffer;
+        fsw_memcpy(name, dirrec->file_identifier, name_len);
+        for (i = name_len - 2; i >= 0; i -= 2) {
+            if (name[i] == 0 && name[i+1] == ';') {
+                name_len = i;   // cut the version number off
+                break;
+            }
+        }
+        if (name_len >= 2 && name[name_len-2] == 0 && name[name_len-1] == '.')
+            name_len -= 2;  // also cut the extension separator if the extension is empty
+        dirrec_buffer->name.type = FSW_STRING_TYPE_UTF16_BE;
+        dirrec_buffer->name.len = name_len / 2;
+        dirrec_buffer->name.size = name_len;
+        dirrec_buffer->name.data = name;
+        dirrec_buffer->mode = 0;
+        return FSW_SUCCESS;
+    }
     
     // setup name
     name_len = dirrec->file_identifier_length;
@@ -417,7 +687,161 @@ static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_shandle *shand, struct is
     dirrec_buffer->name.type = FSW_STRING_TYPE_ISO88591;
     dirrec_buffer->name.len = dirrec_buffer->name.size = name_len;
     dirrec_buffer->name.data = dirrec->file_identifier;
+    dirrec_buffer->mode = 0;
     
+    // Rock Ridge entries may give the real name and the Posix mode
+    if (vol->rock_ridge)
+        return fsw_iso9660_susp_parse(vol, dirrec, dirrec_buffer, NULL, NULL);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Release the directory sector held by a directory record buffer.
+ */
+
+static void fsw_iso9660_release_dirrec(struct fsw_iso9660_volume *vol,
+                                       struct iso9660_dirrec_buffer *dirrec_buffer)
+{
+    if (dirrec_buffer->buffer != NULL) {
+        fsw_block_release(vol, dirrec_buffer->phys_bno, dirrec_buffer->buffer);
+        dirrec_buffer->buffer = NULL;
+    }
+    dirrec_buffer->dirrec = NULL;
+}
+
+/**
+ * Parse the Rock Ridge entries in the System Use area of a directory record. Continuation
+ * areas (CE entries) in other sectors are followed. An NM entry replaces the name in
+ * dirrec_buffer, which then points into its name_buffer, and a PX entry sets its mode.
+ * If link is not NULL, the components of the SL entries are assembled into a symlink
+ * target path there; the buffer must hold FSW_PATH_MAX bytes.
+ */
+
+static fsw_status_t fsw_iso9660_susp_parse(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec,
+                                           struct iso9660_dirrec_buffer *dirrec_buffer,
+                                           fsw_u8 *link, fsw_u32 *link_size)
+{
+    fsw_status_t    status;
+    fsw_u8          *area, *p, *name, *ce_buffer;
+    fsw_u32         area_size, offset, entry_len, comp_len, name_size, i;
+    fsw_u32         ce_bno, ce_offset, ce_size, ce_held_bno, ce_count;
+    int             have_name, separate;
+    
+    name = (fsw_u8 *)dirrec_buffer->name_buffer;
+    name_size = 0;
+    have_name = 0;
+    separate = 0;
+    if (link != NULL)
+        *link_size = 0;
+    
+    // the System Use area follows the name, padded to an even offset
+    offset = 33 + dirrec->file_identifier_length + ((dirrec->file_identifier_length & 1) ? 0 : 1) +
+        vol->susp_skip;
+    if (offset >= dirrec->dirrec_length)
+        return FSW_SUCCESS;
+    area = (fsw_u8 *)dirrec + offset;
+    area_size = dirrec->dirrec_length - offset;
+    
+    status = FSW_SUCCESS;
+    ce_buffer = NULL;
+    ce_held_bno = 0;
+    ce_count = 0;
+    while (1) {
+        ce_size = 0;
+        for (p = area; p + 4 <= area + area_size; p += entry_len) {
+            entry_len = p[2];
+            if (entry_len < 4 || p + entry_len > area + area_size)
+                break;
+            
+            if (p[0] == 'S' && p[1] == 'T') {
+                break;  // end of the System Use entries
+                
+            } else if (p[0] == 'C' && p[1] == 'E' && entry_len >= 28) {
+                ce_bno = ISO9660_LE32(p + 4);
+                ce_offset = ISO9660_LE32(p + 12);
+                ce_size = ISO9660_LE32(p + 20);
+                
+            } else if (p[0] == 'P' && p[1] == 'X' && entry_len >= 12) {
+                dirrec_buffer->mode = ISO9660_LE32(p + 4);
+                
+            } else if (p[0] == 'N' && p[1] == 'M' && entry_len >= 5) {
+                if (p[4] & (ISO9660_RR_NM_CURRENT | ISO9660_RR_NM_PARENT))
+                    continue;
+                for (i = 5; i < entry_len && name_size < sizeof(dirrec_buffer->name_buffer); i++)
+                    name[name_size++] = p[i];
+                have_name = 1;
+                
+            } else if (p[0] == 'S' && p[1] == 'L' && entry_len >= 5 && link != NULL) {
+                for (i = 5; i + 2 <= entry_len && status == FSW_SUCCESS; i += 2 + comp_len) {
+                    comp_len = p[i+1];
+                    if (i + 2 + comp_len > entry_len)
+                        break;
+                    if (separate)
+                        status = fsw_iso9660_link_append(link, link_size, "/", 1);
+                    if (p[i] & ISO9660_RR_SL_ROOT) {
+                        if (status == FSW_SUCCESS)
+                            status = fsw_iso9660_link_append(link, link_size, "/", 1);
+                        separate = 0;
+                        continue;
+                    }
+                    if (status == FSW_SUCCESS) {
+                        if (p[i] & ISO9660_RR_SL_CURRENT)
+                            status = fsw_iso9660_link_append(link, link_size, ".", 1);
+                        else if (p[i] & ISO9660_RR_SL_PARENT)
+                            status = fsw_iso9660_link_append(link, link_size, "..", 2);
+                        else
+                            status = fsw_iso9660_link_append(link, link_size, p + i + 2, comp_len);
+                    }
+                    // a component flagged to continue goes on in the next component record
+                    separate = !(p[i] & ISO9660_RR_SL_CONTINUE);
+                }
+                if (status)
+                    break;
+            }
+        }
+        if (status)
+            break;
+        
+        // follow the continuation area, if any
+        if (ce_size == 0)
+            break;
+        if (++ce_count > ISO9660_SUSP_MAX_CE || ce_offset >= ISO9660_BLOCKSIZE ||
+            ce_size > ISO9660_BLOCKSIZE - ce_offset) {
+            status = FSW_VOLUME_CORRUPTED;
+            break;
+        }
+        if (ce_buffer != NULL)
+            fsw_block_release(vol, ce_held_bno, ce_buffer);
+        status = fsw_block_get(vol, ce_bno, 1, (void **)&ce_buffer);
+        if (status) {
+            ce_buffer = NULL;
+            break;
+        }
+        ce_held_bno = ce_bno;
+        area = ce_buffer + ce_offset;
+        area_size = ce_size;
+    }
+    if (ce_buffer != NULL)
+        fsw_block_release(vol, ce_held_bno, ce_buffer);
+    
+    if (have_name && name_size > 0) {
+        dirrec_buffer->name.type = FSW_STRING_TYPE_ISO88591;
+        dirrec_buffer->name.len = dirrec_buffer->name.size = name_size;
+        dirrec_buffer->name.data = name;
+    }
+    return status;
+}
+
+/**
+ * Append a piece to a symlink target being assembled from Rock Ridge SL entries.
+ */
+
+static fsw_status_t fsw_iso9660_link_append(fsw_u8 *link, fsw_u32 *link_size, const void *data, fsw_u32 len)
+{
+    if (*link_size + len > FSW_PATH_MAX)
+        return FSW_VOLUME_CORRUPTED;
+    fsw_memcpy(link + *link_size, data, len);
+    *link_size += len;
     return FSW_SUCCESS;
 }
 
@@ -426,21 +850,56 @@ static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_shandle *shand, struct is
  * link needs to be resolved. The core makes sure that the fsw_iso9660_dnode_fill has been
  * called on the dnode and that it really is a symlink.
  *
- * For iso9660, the target path can be stored inline in the inode structure (in the space
- * otherwise occupied by the block pointers) or in the inode's data. There is no flag
- * indicating this, only the number of blocks entry (i_blocks) can be used as an
- * indication. The check used here comes from the Linux kernel.
+ * For iso9660, symbolic links only exist with the Rock Ridge extensions, which store the
+ * target path as SL entries in the System Use area of the directory record. The dnode ID
+ * encodes the position of that record, so it is read again from there. Without Rock Ridge,
+ * the file data is used as the target path.
  */
 
 static fsw_status_t fsw_iso9660_readlink(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                          struct fsw_string *link_target)
 {
     fsw_status_t    status;
+    fsw_u32         phys_bno, offset, link_size;
+    fsw_u8          *buffer, *link;
+    struct iso9660_dirrec *dirrec;
+    struct iso9660_dirrec_buffer dirrec_buffer;
+    struct fsw_string s;
     
-    if (dno->g.size > FSW_PATH_MAX)
+    if (!vol->rock_ridge) {
+        if (dno->g.size > FSW_PATH_MAX)
+            return FSW_VOLUME_CORRUPTED;
+        return fsw_dnode_readlink_data(dno, link_target);
+    }
+    
+    phys_bno = (fsw_u32)FSW_U64_SHR(dno->g.dnode_id, ISO9660_BLOCKSIZE_BITS);
+    offset = (fsw_u32)dno->g.dnode_id & (ISO9660_BLOCKSIZE - 1);
+    status = fsw_block_get(vol, phys_bno, 1, (void **)&buffer);
+    if (status)
+        return status;
+    dirrec = (struct iso9660_dirrec *)(buffer + offset);
+    if (offset + 33 > ISO9660_BLOCKSIZE || dirrec->dirrec_length < 33 ||
+        offset + dirrec->dirrec_length > ISO9660_BLOCKSIZE ||
+        dirrec->dirrec_length < 33 + dirrec->file_identifier_length) {
+        fsw_block_release(vol, phys_bno, buffer);
         return FSW_VOLUME_CORRUPTED;
+    }
     
-    status = fsw_dnode_readlink_data(dno, link_target);
+    link = NULL;
+    status = fsw_alloc(FSW_PATH_MAX, &link);
+    if (status == FSW_SUCCESS) {
+        dirrec_buffer.mode = 0;
+        status = fsw_iso9660_susp_parse(vol, dirrec, &dirrec_buffer, link, &link_size);
+    }
+    fsw_block_release(vol, phys_bno, buffer);
+    if (status == FSW_SUCCESS) {
+        s.type = FSW_STRING_TYPE_ISO88591;
+        s.len = s.size = link_size;
+        s.data = link;
+        status = fsw_strdup_coerce(link_target, vol->g.host_string_type, &s);
+    }
+    if (link != NULL)
+        fsw_free(link);
     
     return status;
 }
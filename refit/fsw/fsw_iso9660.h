@@ -49,6 +49,28 @@
 //! Block number where the ISO9660 superblock resides.
 #define ISO9660_SUPERBLOCK_BLOCKNO   16
 
+//! Volume descriptor types.
+#define ISO9660_VD_PRIMARY            1
+#define ISO9660_VD_SUPPLEMENTARY      2
+#define ISO9660_VD_TERMINATOR       255
+
+//! Directory record file flags.
+#define ISO9660_FILE_FLAG_DIRECTORY     0x02
+#define ISO9660_FILE_FLAG_MULTI_EXTENT  0x80
+
+//! Marker for "no directory position".
+#define ISO9660_NO_POS       (~(fsw_u64)0)
+//! Maximum number of continuation areas (CE entries) followed for one directory record.
+#define ISO9660_SUSP_MAX_CE          16
+//! Rock Ridge NM entry flags.
+#define ISO9660_RR_NM_CURRENT      0x02
+#define ISO9660_RR_NM_PARENT       0x04
+//! Rock Ridge SL entry and component flags.
+#define ISO9660_RR_SL_CONTINUE     0x01
+#define ISO9660_RR_SL_CURRENT      0x02
+#define ISO9660_RR_SL_PARENT       0x04
+#define ISO9660_RR_SL_ROOT         0x08
+
 
 #pragma pack(1)
 
@@ -63,6 +85,9 @@ typedef struct {
 } iso9660_u32;
 
 #define ISOINT(lsbmsbvalue) ((lsbmsbvalue).lsb)
+//! Little endian 32-bit value at an unaligned byte address (e.g. in a System Use entry).
+#define ISO9660_LE32(p) ((fsw_u32)(p)[0] | ((fsw_u32)(p)[1] << 8) | \
+                         ((fsw_u32)(p)[2] << 16) | ((fsw_u32)(p)[3] << 24))
 
 struct iso9660_dirrec {
     fsw_u8      dirrec_length;
@@ -96,7 +121,7 @@ struct iso9660_primary_volume_descriptor {
     char        volume_identifier[32];
     fsw_u8      unused2[8];
     iso9660_u32 volume_space_size;
-    fsw_u8      unused3[32];
+    fsw_u8      escape_sequences[32];   // unused in the Primary Volume Descriptor, Joliet marker in a Supplementary one
     iso9660_u16 volume_set_size;
     iso9660_u16 volume_sequence_number;
     iso9660_u16 logical_block_size;
@@ -128,11 +153,30 @@ struct iso9660_primary_volume_descriptor {
 
 #pragma pack()
 
+/**
+ * ISO9660: A directory record parsed in place. The record points into the directory
+ * sector that is held from the block cache until the next sector is needed or
+ * fsw_iso9660_release_dirrec is called.
+ */
+
 struct iso9660_dirrec_buffer {
-    fsw_u32     ino;
-    struct fsw_string name;
-    struct iso9660_dirrec dirrec;
-    char        dirrec_buffer[222];
+    fsw_u64     dirrec_pos;         //!< Byte position of the record on disk, used as the dnode id
+    struct fsw_string name;         //!< File name, pointing into the record
+    struct iso9660_dirrec *dirrec;  //!< The record in the sector buffer, or NULL at the end of the directory
+    fsw_u32     phys_bno;           //!< Physical block number of the held directory sector
+    fsw_u8      *buffer;            //!< Data of the held directory sector, or NULL
+    fsw_u32     mode;               //!< Posix mode from a Rock Ridge PX entry, 0 if there is none
+    fsw_u16     name_buffer[128];   //!< Name assembled from Rock Ridge NM entries or a Joliet name
+};
+
+
+/**
+ * ISO9660: One run of sectors of a multi-extent file.
+ */
+
+struct fsw_iso9660_extent {
+    fsw_u32     phys_start;         //!< First sector of the run
+    fsw_u32     count;              //!< Number of sectors in the run
 };
 
 
@@ -144,6 +188,10 @@ struct fsw_iso9660_volume {
     struct fsw_volume g;            //!< Generic volume structure
     
     struct iso9660_primary_volume_descriptor *primary_voldesc;  //!< Full Primary Volume Descriptor
+    struct iso9660_dirrec joliet_root;  //!< Root directory record from a Joliet Supplementary Volume Descriptor
+    int         joliet;             //!< Names are taken from the Joliet directory tree (UCS-2)
+    int         rock_ridge;         //!< Directory records carry Rock Ridge entries (SUSP)
+    fsw_u32     susp_skip;          //!< Bytes to skip at the start of each System Use area (from the SP entry)
 };
 
 /**
@@ -154,6 +202,9 @@ struct fsw_iso9660_dnode {
     struct fsw_dnode g;             //!< Generic dnode structure
     
     struct iso9660_dirrec dirrec;   //!< Fixed part of the directory record (i.e. w/o name)
+    fsw_u32     mode;               //!< Posix mode from Rock Ridge, 0 if not available
+    struct fsw_iso9660_extent *extents; //!< Sector runs of a multi-extent file, NULL for a single extent
+    fsw_u32     extent_count;       //!< Number of entries in extents
 };
 
 
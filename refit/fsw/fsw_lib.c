@@ -158,6 +158,90 @@ int fsw_streq_cstr(struct fsw_string *s1, const char *s2)
     return fsw_streq(s1, &temp_s);
 }
 
+/**
+ * Get the next character from a string buffer of the given type and advance the
+ * buffer pointer.
+ */
+
+static fsw_u32 fsw_str_getnext(int type, fsw_u8 **p)
+{
+    fsw_u32 c;
+    fsw_u16 u;
+    
+    if (type == FSW_STRING_TYPE_UTF16 || type == FSW_STRING_TYPE_UTF16_SWAPPED) {
+        fsw_memcpy(&u, *p, sizeof(fsw_u16));    // the data may be unaligned
+        *p += sizeof(fsw_u16);
+        return (type == FSW_STRING_TYPE_UTF16) ? u : FSW_SWAPVALUE_U16(u);
+    }
+    
+    c = *(*p)++;
+    if (type == FSW_STRING_TYPE_UTF8) {
+        if ((c & 0xe0) == 0xc0) {
+            c = ((c & 0x1f) << 6) | (*(*p)++ & 0x3f);
+        } else if ((c & 0xf0) == 0xe0) {
+            c = ((c & 0x0f) << 12) | ((*(*p)++ & 0x3f) << 6);
+            c |= (*(*p)++ & 0x3f);
+        } else if ((c & 0xf8) == 0xf0) {
+            c = ((c & 0x07) << 18) | ((*(*p)++ & 0x3f) << 12);
+            c |= ((*(*p)++ & 0x3f) << 6);
+            c |= (*(*p)++ & 0x3f);
+        }
+    }
+    return c;
+}
+
+/**
+ * Fold a character for case-insensitive comparison. Covers the letters of
+ * ISO 8859-1, which is what file names on the supported file systems use in practice.
+ */
+
+static fsw_u32 fsw_char_fold(fsw_u32 c)
+{
+    if ((c >= 'A' && c <= 'Z') || (c >= 0xc0 && c <= 0xde && c != 0xd7))
+        return c + 0x20;
+    return c;
+}
+
+/**
+ * Compare two strings for equality, ignoring case. Works like fsw_streq, but
+ * letters are compared case-insensitively (see fsw_char_fold).
+ */
+
+int fsw_streq_nocase(struct fsw_string *s1, struct fsw_string *s2)
+{
+    int     i;
+    fsw_u8  *p1, *p2;
+    
+    if (fsw_strlen(s1) != fsw_strlen(s2))
+        return 0;
+    
+    p1 = (fsw_u8 *)s1->data;
+    p2 = (fsw_u8 *)s2->data;
+    for (i = fsw_strlen(s1); i > 0; i--) {
+        if (fsw_char_fold(fsw_str_getnext(s1->type, &p1)) != fsw_char_fold(fsw_str_getnext(s2->type, &p2)))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Compute a hash value for a string, ignoring case. Strings that are equal according
+ * to fsw_streq_nocase get the same hash value, whatever their string types.
+ */
+
+fsw_u32 fsw_strhash_nocase(struct fsw_string *s, fsw_u32 seed)
+{
+    fsw_u32 h;
+    int     i;
+    fsw_u8  *p;
+    
+    h = 2166136261UL ^ seed;
+    p = (fsw_u8 *)s->data;
+    for (i = fsw_strlen(s); i > 0; i--)
+        h = (h ^ fsw_char_fold(fsw_str_getnext(s->type, &p))) * 16777619UL;
+    return h ^ (h >> 16);
+}
+
 /**
  * Creates a duplicate of a string, converting it to the given encoding during the copy.
  * If the function returns FSW_SUCCESS, the caller must free the string later with
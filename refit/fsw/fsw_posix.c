@@ -43,16 +43,32 @@
 #define FSTYPE ext2
 #endif
 
+#ifndef FSW_POSIX_BCACHE_BUDGET
+/** The block cache memory budget per volume in bytes. */
+#define FSW_POSIX_BCACHE_BUDGET (4*1024*1024)
+#endif
+
+#ifndef FSW_POSIX_USE_MMAP
+/** Map the device into memory and hand out blocks without copying them (1) or read every block (0). */
+#define FSW_POSIX_USE_MMAP (1)
+#endif
+
 
 // function prototypes
 
 fsw_status_t fsw_posix_open_dno(struct fsw_posix_volume *pvol, const char *path, int required_type,
                                 struct fsw_shandle *shand);
+static fsw_status_t fsw_posix_dir_fill_batch(struct fsw_posix_dir *dir);
+static void fsw_posix_dir_drop_batch(struct fsw_posix_dir *dir);
 
 void fsw_posix_change_blocksize(struct fsw_volume *vol,
                               fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                               fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
+fsw_status_t fsw_posix_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer);
+fsw_status_t fsw_posix_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+
+static void fsw_posix_map(struct fsw_posix_volume *pvol);
 
 /**
  * Dispatch table for our FSW host driver.
@@ -60,9 +76,13 @@ fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void
 
 struct fsw_host_table   fsw_posix_host_table = {
     FSW_STRING_TYPE_ISO88591,
+    FSW_POSIX_BCACHE_BUDGET,
     
     fsw_posix_change_blocksize,
-    fsw_posix_read_block
+    fsw_posix_read_block,
+    fsw_posix_read_blocks,
+    fsw_posix_block_get,
+    NULL
 };
 
 extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(FSTYPE);
@@ -91,12 +111,18 @@ struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_ta
         return NULL;
     }
     
+    // map it if possible, the blocks are then served straight from the mapping
+    fsw_posix_map(pvol);
+    
     // mount the filesystem
     if (fstype_table == NULL)
         fstype_table = &FSW_FSTYPE_TABLE_NAME(FSTYPE);
     status = fsw_mount(pvol, &fsw_posix_host_table, fstype_table, &pvol->vol);
     if (status) {
         fprintf(stderr, "fsw_posix_mount: fsw_mount returned %d\n", status);
+        if (pvol->map != NULL)
+            munmap(pvol->map, (size_t)pvol->map_size);
+        close(pvol->fd);
         fsw_free(pvol);
         return NULL;
     }
@@ -104,6 +130,29 @@ struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_ta
     return pvol;
 }
 
+/**
+ * Map the underlying file or device read-only into memory. This is an optimization
+ * only; if the size cannot be determined or the mapping fails (e.g. because the
+ * image does not fit into the address space), blocks are read with system calls.
+ */
+
+static void fsw_posix_map(struct fsw_posix_volume *pvol)
+{
+#if FSW_POSIX_USE_MMAP
+    off_t           size;
+    void            *map;
+    
+    size = lseek(pvol->fd, 0, SEEK_END);
+    if (size <= 0 || (fsw_u64)size != (fsw_u64)(size_t)size)
+        return;
+    map = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, pvol->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    pvol->map = map;
+    pvol->map_size = size;
+#endif
+}
+
 /**
  * Unmount function.
  */
@@ -112,6 +161,9 @@ int fsw_posix_unmount(struct fsw_posix_volume *pvol)
 {
     if (pvol->vol != NULL)
         fsw_unmount(pvol->vol);
+    if (pvol->map != NULL)
+        munmap(pvol->map, (size_t)pvol->map_size);
+    close(pvol->fd);
     fsw_free(pvol);
     return 0;
 }
@@ -209,6 +261,8 @@ struct fsw_posix_dir * fsw_posix_opendir(struct fsw_posix_volume *pvol, const ch
     if (status)
         return NULL;
     dir->pvol = pvol;
+    dir->batch_count = 0;
+    dir->batch_index = 0;
     
     // open the directory
     status = fsw_posix_open_dno(pvol, path, FSW_DNODE_TYPE_DIR, &dir->shand);
@@ -231,13 +285,21 @@ struct dirent * fsw_posix_readdir(struct fsw_posix_dir *dir)
     struct fsw_dnode    *dno;
     static struct dirent dent;
     
-    // get next entry from file system
-    status = fsw_dnode_dir_read(&dir->shand, &dno);
-    if (status) {
-        fprintf(stderr, "fsw_posix_readdir: fsw_dnode_dir_read returned %d\n", status);
-        return NULL;
+    // get next entry, reading ahead a batch of entries from the file system as needed
+    if (dir->batch_index >= dir->batch_count) {
+        status = fsw_posix_dir_fill_batch(dir);
+        if (status) {
+            fprintf(stderr, "fsw_posix_readdir: fsw_dnode_dir_read returned %d\n", status);
+            return NULL;
+        }
     }
-    status = fsw_dnode_fill(dno);
+    dno = dir->batch[dir->batch_index++];
+    
+    // the type may already be known from the directory entry, no need to read the inode then
+    if (dno->type == FSW_DNODE_TYPE_UNKNOWN)
+        status = fsw_dnode_fill(dno);
+    else
+        status = FSW_SUCCESS;
     if (status) {
         fprintf(stderr, "fsw_posix_readdir: fsw_dnode_fill returned %d\n", status);
         fsw_dnode_release(dno);
@@ -265,15 +327,61 @@ struct dirent * fsw_posix_readdir(struct fsw_posix_dir *dir)
     memcpy(dent.d_name, dno->name.data, dno->name.size);
     dent.d_name[dent.d_namlen] = 0;
     
+    fsw_dnode_release(dno);
     return &dent;
 }
 
+/**
+ * Read the next batch of entries from a directory and fill them in one go,
+ * so that inode information stored close together on disk is read only once.
+ */
+
+static fsw_status_t fsw_posix_dir_fill_batch(struct fsw_posix_dir *dir)
+{
+    fsw_status_t        status;
+    struct fsw_dnode    *unfilled[FSW_DNODE_FILL_BATCH];
+    fsw_u32             unfilled_count;
+    
+    dir->batch_count = 0;
+    dir->batch_index = 0;
+    unfilled_count = 0;
+    while (dir->batch_count < FSW_DNODE_FILL_BATCH) {
+        status = fsw_dnode_dir_read(&dir->shand, &dir->batch[dir->batch_count]);
+        if (status) {
+            if (dir->batch_count == 0)
+                return status;
+            break;      // report the error once the entries read so far are used up
+        }
+        if (dir->batch[dir->batch_count]->type == FSW_DNODE_TYPE_UNKNOWN)
+            unfilled[unfilled_count++] = dir->batch[dir->batch_count];
+        dir->batch_count++;
+    }
+    
+    // only entries without a type from the directory need their inode;
+    //  errors are reported by fsw_dnode_fill for each single entry
+    fsw_dnode_fill_many(unfilled, unfilled_count);
+    return FSW_SUCCESS;
+}
+
+/**
+ * Release the entries that were read ahead but not yet returned.
+ */
+
+static void fsw_posix_dir_drop_batch(struct fsw_posix_dir *dir)
+{
+    while (dir->batch_index < dir->batch_count)
+        fsw_dnode_release(dir->batch[dir->batch_index++]);
+    dir->batch_count = 0;
+    dir->batch_index = 0;
+}
+
 /**
  * Rewind a directory to the start.
  */
 
 void fsw_posix_rewinddir(struct fsw_posix_dir *dir)
 {
+    fsw_posix_dir_drop_batch(dir);
     dir->shand.pos = 0;
 }
 
@@ -283,6 +391,7 @@ void fsw_posix_rewinddir(struct fsw_posix_dir *dir)
 
 int fsw_posix_closedir(struct fsw_posix_dir *dir)
 {
+    fsw_posix_dir_drop_batch(dir);
     fsw_shandle_close(&dir->shand);
     fsw_free(dir);
     return 0;
@@ -359,27 +468,83 @@ void fsw_posix_change_blocksize(struct fsw_volume *vol,
  * to read a block of data from the device. The buffer is allocated by the core code.
  */
 
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer)
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
 {
     struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
-    off_t           block_offset, seek_result;
+    off_t           block_offset;
     ssize_t         read_result;
     
-    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_block: %d  (%d)\n"), phys_bno, vol->phys_blocksize));
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_block: %lld  (%d)\n"), phys_bno, vol->phys_blocksize));
     
     // read from disk
     block_offset = (off_t)phys_bno * vol->phys_blocksize;
-    seek_result = lseek(pvol->fd, block_offset, SEEK_SET);
-    if (seek_result != block_offset)
+    if (pvol->map != NULL) {
+        if ((fsw_u64)block_offset + vol->phys_blocksize > pvol->map_size)
+            return FSW_IO_ERROR;
+        fsw_memcpy(buffer, pvol->map + block_offset, vol->phys_blocksize);
+        return FSW_SUCCESS;
+    }
+    read_result = pread(pvol->fd, buffer, vol->phys_blocksize, block_offset);
+    if (read_result < 0 || (size_t)read_result != vol->phys_blocksize)
         return FSW_IO_ERROR;
-    read_result = read(pvol->fd, buffer, vol->phys_blocksize);
-    if (read_result != vol->phys_blocksize)
+    
+    return FSW_SUCCESS;
+}
+
+/**
+ * FSW interface function to read a run of consecutive data blocks. This function is
+ * called by the FSW core to read file data directly into the caller's buffer. The whole
+ * run is transferred with a single system call.
+ */
+
+fsw_status_t fsw_posix_read_blocks(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 count, void *buffer)
+{
+    struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
+    off_t           block_offset;
+    size_t          read_size;
+    ssize_t         read_result;
+    
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_blocks: %lld+%d  (%d)\n"), phys_bno, count, vol->phys_blocksize));
+    
+    // read from disk
+    block_offset = (off_t)phys_bno * vol->phys_blocksize;
+    read_size = (size_t)count * vol->phys_blocksize;
+    if (pvol->map != NULL) {
+        if ((fsw_u64)block_offset + read_size > pvol->map_size)
+            return FSW_IO_ERROR;
+        fsw_memcpy(buffer, pvol->map + block_offset, read_size);
+        return FSW_SUCCESS;
+    }
+    read_result = pread(pvol->fd, buffer, read_size, block_offset);
+    if (read_result < 0 || (size_t)read_result != read_size)
         return FSW_IO_ERROR;
     
     return FSW_SUCCESS;
 }
 
 
+/**
+ * FSW interface function to get a block without copying it. This function is called
+ * by the FSW core before it looks into its own block cache. When the device is mapped
+ * into memory, the block's address in the mapping is returned; the page cache of the
+ * operating system does the caching then. Otherwise the core's cache is used.
+ */
+
+fsw_status_t fsw_posix_block_get(struct fsw_volume *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out)
+{
+    struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
+    fsw_u64         block_offset;
+    
+    if (pvol->map == NULL)
+        return FSW_UNSUPPORTED;
+    
+    block_offset = (fsw_u64)phys_bno * vol->phys_blocksize;
+    if (block_offset + vol->phys_blocksize > pvol->map_size)
+        return FSW_IO_ERROR;
+    *buffer_out = pvol->map + block_offset;
+    return FSW_SUCCESS;
+}
+
 /**
  * Time mapping callback for the fsw_dnode_stat call. This function converts
  * a Posix style timestamp into an EFI_TIME structure and writes it to the
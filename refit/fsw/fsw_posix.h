@@ -42,6 +42,7 @@
 
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/dir.h>
 
 
@@ -54,6 +55,9 @@ struct fsw_posix_volume {
     
     int                         fd;             //!< System file descriptor for data access
     
+    fsw_u8                      *map;           //!< Read-only mapping of the whole device, or NULL
+    fsw_u64                     map_size;       //!< Size of the mapping in bytes
+    
 };
 
 /**
@@ -76,6 +80,10 @@ struct fsw_posix_dir {
     
     struct fsw_shandle          shand;          //!< FSW handle for this file
     
+    struct fsw_dnode            *batch[FSW_DNODE_FILL_BATCH];   //!< Entries read ahead and filled as one batch
+    fsw_u32                     batch_count;    //!< Number of entries in the batch
+    fsw_u32                     batch_index;    //!< Next entry of the batch to return
+    
 };
 
 
@@ -44,15 +44,28 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
 
 static fsw_status_t fsw_reiserfs_readlink(struct fsw_reiserfs_volume *vol, struct fsw_reiserfs_dnode *dno,
                                       struct fsw_string *link);
+static void fsw_reiserfs_shandle_close(struct fsw_reiserfs_volume *vol, struct fsw_shandle *shand);
 
 static fsw_status_t fsw_reiserfs_item_search(struct fsw_reiserfs_volume *vol,
                                              fsw_u32 dir_id, fsw_u32 objectid, fsw_u64 offset,
                                              struct fsw_reiserfs_item *item);
 static fsw_status_t fsw_reiserfs_item_next(struct fsw_reiserfs_volume *vol,
                                            struct fsw_reiserfs_item *item);
+static fsw_status_t fsw_reiserfs_item_prev(struct fsw_reiserfs_volume *vol,
+                                           struct fsw_reiserfs_item *item);
+static fsw_status_t fsw_reiserfs_item_path_get(struct fsw_reiserfs_volume *vol,
+                                               struct fsw_reiserfs_item *item,
+                                               fsw_u32 tree_level, fsw_u32 tree_bno);
+static fsw_status_t fsw_reiserfs_item_fill(struct fsw_reiserfs_volume *vol,
+                                           struct fsw_reiserfs_item *item,
+                                           fsw_u32 dir_id, fsw_u32 objectid);
 static void fsw_reiserfs_item_release(struct fsw_reiserfs_volume *vol,
                                       struct fsw_reiserfs_item *item);
 
+static fsw_u32 fsw_reiserfs_hash_tea(fsw_u8 *name, fsw_u32 len);
+static fsw_u32 fsw_reiserfs_hash_rupasov(fsw_u8 *name, fsw_u32 len);
+static fsw_u32 fsw_reiserfs_hash_r5(fsw_u8 *name, fsw_u32 len);
+
 //
 // Dispatch Table
 //
@@ -72,6 +85,8 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(reiserfs) = {
     fsw_reiserfs_dir_lookup,
     fsw_reiserfs_dir_read,
     fsw_reiserfs_readlink,
+    fsw_reiserfs_shandle_close,
+    NULL,
 };
 
 // misc data
@@ -131,6 +146,8 @@ static fsw_status_t fsw_reiserfs_volume_mount(struct fsw_reiserfs_volume *vol)
     // check the superblock
     if (vol->sb->s_v1.s_root_block == -1)   // unfinished 'reiserfsck --rebuild-tree'
         return FSW_VOLUME_CORRUPTED;
+    if (vol->sb->s_v1.s_tree_height > MAX_HEIGHT)
+        return FSW_VOLUME_CORRUPTED;
     
     /*
     if (vol->sb->s_rev_level != EXT2_GOOD_OLD_REV &&
@@ -145,6 +162,16 @@ static fsw_status_t fsw_reiserfs_volume_mount(struct fsw_reiserfs_volume *vol)
     blocksize = vol->sb->s_v1.s_blocksize;
     fsw_set_blocksize(vol, blocksize, blocksize);
     
+    // select the hash function used to sort directory entries
+    if (vol->sb->s_v1.s_hash_function_code == TEA_HASH)
+        vol->hash_function = fsw_reiserfs_hash_tea;
+    else if (vol->sb->s_v1.s_hash_function_code == YURA_HASH)
+        vol->hash_function = fsw_reiserfs_hash_rupasov;
+    else if (vol->sb->s_v1.s_hash_function_code == R5_HASH)
+        vol->hash_function = fsw_reiserfs_hash_r5;
+    else
+        vol->hash_function = NULL;  // unknown, dir_lookup scans the whole directory
+    
     // get other info from superblock
     /*
     vol->ind_bcnt = EXT2_ADDR_PER_BLOCK(vol->sb);
@@ -214,12 +241,12 @@ static fsw_status_t fsw_reiserfs_dnode_fill(struct fsw_reiserfs_volume *vol, str
     if (dno->sd_v1 || dno->sd_v2)
         return FSW_SUCCESS;
     
-    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_dnode_fill: object %d/%d\n"), dno->dir_id, dno->g.dnode_id));
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_dnode_fill: object %d/%lld\n"), dno->dir_id, dno->g.dnode_id));
     
     // find stat data item in reiserfs tree
     status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, 0, &item);
     if (status == FSW_NOT_FOUND) {
-        FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_dnode_fill: cannot find stat_data for object %d/%d\n"),
+        FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_dnode_fill: cannot find stat_data for object %d/%lld\n"),
                         dno->dir_id, dno->g.dnode_id));
         return FSW_VOLUME_CORRUPTED;
     }
@@ -239,6 +266,7 @@ static fsw_status_t fsw_reiserfs_dnode_fill(struct fsw_reiserfs_volume *vol, str
         fsw_reiserfs_item_release(vol, &item);
         if (status)
             return status;
+        fsw_dnode_account(dno, 0, item_len);
         
         // get info from the inode
         dno->g.size = dno->sd_v1->sd_size;
@@ -250,6 +278,7 @@ static fsw_status_t fsw_reiserfs_dnode_fill(struct fsw_reiserfs_volume *vol, str
         fsw_reiserfs_item_release(vol, &item);
         if (status)
             return status;
+        fsw_dnode_account(dno, 0, item_len);
         
         // get info from the inode
         dno->g.size = dno->sd_v2->sd_size;
@@ -325,6 +354,10 @@ static fsw_status_t fsw_reiserfs_dnode_stat(struct fsw_reiserfs_volume *vol, str
  * data can be found. The core makes sure that fsw_reiserfs_dnode_fill has been called
  * on the dnode before. Our task here is to get the physical disk block number for
  * the requested logical block number.
+ *
+ * For indirect items, the returned extent covers all following block numbers that are
+ * consecutive on disk, within the item and across the following indirect items of the
+ * same object. Runs of null block numbers (holes) are combined into a sparse extent.
  */
 
 static fsw_status_t fsw_reiserfs_get_extent(struct fsw_reiserfs_volume *vol, struct fsw_reiserfs_dnode *dno,
@@ -333,13 +366,14 @@ static fsw_status_t fsw_reiserfs_get_extent(struct fsw_reiserfs_volume *vol, str
     fsw_status_t    status;
     fsw_u64         search_offset, intra_offset;
     struct fsw_reiserfs_item item;
-    fsw_u32         intra_bno, nr_item;
+    fsw_u32         intra_bno, nr_item, i, file_bcnt, first_bno, *bnos;
+    fsw_u64         next_item_offset;
     
     // Preconditions: The caller has checked that the requested logical block
     //  is within the file's size. The dnode has complete information, i.e.
     //  fsw_reiserfs_dnode_read_info was called successfully on it.
     
-    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_get_extent: mapping block %d of object %d/%d\n"),
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_get_extent: mapping block %d of object %d/%lld\n"),
                    extent->log_start, dno->dir_id, dno->g.dnode_id));
     
     extent->type = FSW_EXTENT_TYPE_SPARSE;
@@ -370,10 +404,36 @@ static fsw_status_t fsw_reiserfs_get_extent(struct fsw_reiserfs_volume *vol, str
             FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_get_extent: indirect block too small\n")));
             goto bail;
         }
-        extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
-        extent->phys_start = ((fsw_u32 *)item.item_data)[intra_bno];
+        bnos = (fsw_u32 *)item.item_data + intra_bno;
+        nr_item -= intra_bno;
+        first_bno = bnos[0];
+        if (first_bno != 0) {
+            extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
+            extent->phys_start = first_bno;
+        }
         
-        // TODO: check if the following blocks can be aggregated into one extent
+        // aggregate the following blocks that continue the run
+        file_bcnt = (fsw_u32)FSW_U64_DIV(dno->g.size + vol->g.log_blocksize - 1, vol->g.log_blocksize);
+        extent->log_count = 0;
+        for (;;) {
+            for (i = 0; i < nr_item && extent->log_start + extent->log_count < file_bcnt; i++) {
+                if (bnos[i] != (first_bno ? first_bno + extent->log_count : 0))
+                    break;
+                extent->log_count++;
+            }
+            if (i < nr_item || extent->log_start + extent->log_count >= file_bcnt)
+                break;
+            
+            // the run reaches the end of the item, continue with the next item of the object
+            next_item_offset = item.item_offset + (fsw_u64)(item.ih.ih_item_len / sizeof(fsw_u32)) * vol->g.log_blocksize;
+            if (fsw_reiserfs_item_next(vol, &item))
+                break;
+            if ((item.item_type != TYPE_INDIRECT && item.item_type != V1_INDIRECT_UNIQUENESS) ||
+                item.item_offset != next_item_offset)
+                break;
+            bnos = (fsw_u32 *)item.item_data;
+            nr_item = item.ih.ih_item_len / sizeof(fsw_u32);
+        }
         
         fsw_reiserfs_item_release(vol, &item);
         return FSW_SUCCESS;
@@ -402,18 +462,6 @@ static fsw_status_t fsw_reiserfs_get_extent(struct fsw_reiserfs_volume *vol, str
 bail:
     fsw_reiserfs_item_release(vol, &item);
     return FSW_VOLUME_CORRUPTED;
-    
-    /*    
-    // check if the following blocks can be aggregated into one extent
-    file_bcnt = (fsw_u32)((dno->g.size + vol->g.log_blocksize - 1) & (vol->g.log_blocksize - 1));
-    while (path[i]           + extent->log_count < buf_bcnt &&    // indirect block has more block pointers
-           extent->log_start + extent->log_count < file_bcnt) {   // file has more blocks
-        if (buffer[path[i] + extent->log_count] == buffer[path[i] + extent->log_count - 1] + 1)
-            extent->log_count++;
-        else
-            break;
-    }
-    */
 }
 
 /**
@@ -421,6 +469,10 @@ bail:
  * to retrieve the directory entry with the given name. A dnode is constructed for
  * this entry and returned. The core makes sure that fsw_reiserfs_dnode_fill has been called
  * and the dnode is actually a directory.
+ *
+ * Directory entries are keyed by a hash of their name, with a generation number in the
+ * low bits to resolve collisions. If the volume's hash function is known, only the range
+ * of keys for the name's hash value is searched.
  */
 
 static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, struct fsw_reiserfs_dnode *dno,
@@ -428,20 +480,36 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
 {
     fsw_status_t    status;
     struct fsw_reiserfs_item item;
-    fsw_u32         nr_item, i, name_offset, next_name_offset, name_len;
-    fsw_u32         child_dir_id;
+    fsw_u32         nr_item, i, lo, hi, name_offset, next_name_offset, name_len;
+    fsw_u32         child_dir_id, first_offset, last_offset;
     struct reiserfs_de_head *dhead;
-    struct fsw_string entry_name;
+    struct fsw_string entry_name, disk_name;
     
     // Preconditions: The caller has checked that dno is a directory node.
     
-    // BIG TODOS: Use the hash function to start with the item containing the entry.
-    //  Use binary search within the item.
-    
     entry_name.type = FSW_STRING_TYPE_ISO88591;
     
-    // get the item for that position
-    status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, FIRST_ITEM_OFFSET, &item);
+    // determine the range of entry keys to look at
+    first_offset = FIRST_ITEM_OFFSET;
+    last_offset = 0xffffffffUL;
+    if (fsw_streq_cstr(lookup_name, ".")) {
+        first_offset = last_offset = DOT_OFFSET;
+    } else if (fsw_streq_cstr(lookup_name, "..")) {
+        first_offset = last_offset = DOT_DOT_OFFSET;
+    } else if (vol->hash_function != NULL) {
+        // hash the name in its on-disk form
+        status = fsw_strdup_coerce(&disk_name, FSW_STRING_TYPE_ISO88591, lookup_name);
+        if (status)
+            return status;
+        first_offset = (fsw_u32)GET_HASH_VALUE(vol->hash_function(disk_name.data, disk_name.size));
+        fsw_strfree(&disk_name);
+        if (first_offset == 0)
+            first_offset = 128;     // keys below are used for . and ..
+        last_offset = first_offset + MAX_GENERATION_NUMBER;
+    }
+    
+    // get the item for the first key
+    status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, first_offset, &item);
     if (status)
         return status;
     if (item.item_offset == 0) {
@@ -451,13 +519,31 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
     
     for(;;) {
         
-        // search the directory item
+        // binary search the directory item for the first entry in the key range
         dhead = (struct reiserfs_de_head *)item.item_data;
         nr_item = item.ih.u.ih_entry_count;
-        next_name_offset = item.ih.ih_item_len;
-        for (i = 0; i < nr_item; i++, dhead++, next_name_offset = name_offset) {
+        lo = 0;
+        hi = nr_item;
+        while (lo < hi) {
+            i = (lo + hi) / 2;
+            if (dhead[i].deh_offset < first_offset)
+                lo = i + 1;
+            else
+                hi = i;
+        }
+        
+        for (i = lo; i < nr_item; i++) {
+            if (dhead[i].deh_offset > last_offset) {
+                fsw_reiserfs_item_release(vol, &item);
+                return FSW_NOT_FOUND;
+            }
+            
             // get the name
-            name_offset = dhead->deh_location;
+            name_offset = dhead[i].deh_location;
+            if (i == 0)
+                next_name_offset = item.ih.ih_item_len;
+            else
+                next_name_offset = dhead[i-1].deh_location;
             name_len = next_name_offset - name_offset;
             while (name_len > 0 && item.item_data[name_offset + name_len - 1] == 0)
                 name_len--;
@@ -470,8 +556,8 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
                 // found the entry we're looking for!
                 
                 // setup a dnode for the child item
-                status = fsw_dnode_create(dno, dhead->deh_objectid, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
-                child_dir_id = dhead->deh_dir_id;
+                status = fsw_dnode_create(dno, dhead[i].deh_objectid, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
+                child_dir_id = dhead[i].deh_dir_id;
                 fsw_reiserfs_item_release(vol, &item);
                 if (status)
                     return status;
@@ -481,7 +567,7 @@ static fsw_status_t fsw_reiserfs_dir_lookup(struct fsw_reiserfs_volume *vol, str
             }
         }
         
-        // We didn't find the next directory entry in this item. Look for the next
+        // We didn't find the directory entry in this item. Look for the next
         // item of the directory.
         
         status = fsw_reiserfs_item_next(vol, &item);
@@ -503,7 +589,7 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
                                           struct fsw_shandle *shand, struct fsw_reiserfs_dnode **child_dno_out)
 {
     fsw_status_t    status;
-    struct fsw_reiserfs_item item;
+    struct fsw_reiserfs_item *item;
     fsw_u32         nr_item, i, name_offset, next_name_offset, name_len;
     fsw_u32         child_dir_id;
     struct reiserfs_de_head *dhead;
@@ -513,26 +599,40 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
     //  has opened a storage handle to the directory's storage and keeps it around between
     //  calls.
     
-    // BIG TODOS: Use binary search within the item.
-    
     // adjust pointer to first entry if necessary
     if (shand->pos == 0)
         shand->pos = FIRST_ITEM_OFFSET;
     
-    // get the item for that position
-    status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, shand->pos, &item);
-    if (status)
-        return status;
-    if (item.item_offset == 0) {
-        fsw_reiserfs_item_release(vol, &item);
-        return FSW_NOT_FOUND;       // empty directory or something
+    // the tree cursor is kept with the shandle between calls
+    item = (struct fsw_reiserfs_item *)shand->fs_data;
+    if (item == NULL) {
+        status = fsw_alloc_zero(sizeof(struct fsw_reiserfs_item), (void **)&item);
+        if (status)
+            return status;
+        shand->fs_data = item;
+    }
+    
+    // The cursor is still on the item of the last entry returned, unless the position
+    // was changed by the caller. Step back one item if necessary, else search the item
+    // for that position from scratch.
+    if (item->valid && shand->pos < item->item_offset)
+        fsw_reiserfs_item_prev(vol, item);
+    if (!item->valid || item->item_offset == 0 || shand->pos < item->item_offset) {
+        fsw_reiserfs_item_release(vol, item);
+        status = fsw_reiserfs_item_search(vol, dno->dir_id, dno->g.dnode_id, shand->pos, item);
+        if (status)
+            return status;
+        if (item->item_offset == 0) {
+            fsw_reiserfs_item_release(vol, item);
+            return FSW_NOT_FOUND;       // empty directory or something
+        }
     }
     
     for(;;) {
         
         // search the directory item
-        dhead = (struct reiserfs_de_head *)item.item_data;
-        nr_item = item.ih.u.ih_entry_count;
+        dhead = (struct reiserfs_de_head *)item->item_data;
+        nr_item = item->ih.u.ih_entry_count;
         for (i = 0; i < nr_item; i++, dhead++) {
             if (dhead->deh_offset < shand->pos)
                 continue;  // not yet past the last entry returned
@@ -542,16 +642,16 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
             // get the name
             name_offset = dhead->deh_location;
             if (i == 0)
-                next_name_offset = item.ih.ih_item_len;
+                next_name_offset = item->ih.ih_item_len;
             else
                 next_name_offset = dhead[-1].deh_location;
             name_len = next_name_offset - name_offset;
-            while (name_len > 0 && item.item_data[name_offset + name_len - 1] == 0)
+            while (name_len > 0 && item->item_data[name_offset + name_len - 1] == 0)
                 name_len--;
             
             entry_name.type = FSW_STRING_TYPE_ISO88591;
             entry_name.len = entry_name.size = name_len;
-            entry_name.data = item.item_data + name_offset;
+            entry_name.data = item->item_data + name_offset;
             
             if (fsw_streq_cstr(&entry_name, ".reiserfs_priv"))
                 continue;  // never report this special file
@@ -559,10 +659,9 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
             // found the next entry!
             shand->pos = dhead->deh_offset + 1;
             
-            // setup a dnode for the child item
+            // setup a dnode for the child item, the cursor stays on the current item
             status = fsw_dnode_create(dno, dhead->deh_objectid, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
             child_dir_id = dhead->deh_dir_id;
-            fsw_reiserfs_item_release(vol, &item);
             if (status)
                 return status;
             (*child_dno_out)->dir_id = child_dir_id;
@@ -573,13 +672,28 @@ static fsw_status_t fsw_reiserfs_dir_read(struct fsw_reiserfs_volume *vol, struc
         // We didn't find the next directory entry in this item. Look for the next
         // item of the directory.
         
-        status = fsw_reiserfs_item_next(vol, &item);
+        status = fsw_reiserfs_item_next(vol, item);
         if (status)
             return status;
         
     }
 }
 
+/**
+ * Release the file system specific data of a shandle. This function is called by the
+ * core when a shandle is closed. For directories, the shandle holds the tree cursor
+ * used by fsw_reiserfs_dir_read.
+ */
+
+static void fsw_reiserfs_shandle_close(struct fsw_reiserfs_volume *vol, struct fsw_shandle *shand)
+{
+    struct fsw_reiserfs_item *item = (struct fsw_reiserfs_item *)shand->fs_data;
+    
+    fsw_reiserfs_item_release(vol, item);
+    fsw_free(item);
+    shand->fs_data = NULL;
+}
+
 /**
  * Get the target path of a symbolic link. This function is called when a symbolic
  * link needs to be resolved. The core makes sure that the fsw_reiserfs_dnode_fill has been
@@ -593,43 +707,70 @@ static fsw_status_t fsw_reiserfs_readlink(struct fsw_reiserfs_volume *vol, struc
 }
 
 /**
- * Compare an on-disk tree key against the search key.
+ * Compare an on-disk tree key against the search key. The key IDs are compared first,
+ * so the format of the on-disk offset only needs to be determined for keys of the
+ * object being searched. The format is detected from the type bits in the last byte
+ * of the little-endian key, which avoids a 64-bit shift.
  */
 
-static int fsw_reiserfs_compare_key(struct reiserfs_key *key,
-                                    fsw_u32 dir_id, fsw_u32 objectid, fsw_u64 offset)
+static int fsw_reiserfs_compare_key(struct reiserfs_key *key, struct fsw_reiserfs_search_key *skey)
 {
     fsw_u32 key_type;
     fsw_u64 key_offset;
     
-    if (key->k_dir_id > dir_id)
-        return FIRST_GREATER;
-    if (key->k_dir_id < dir_id)
-        return SECOND_GREATER;
-    
-    if (key->k_objectid > objectid)
-        return FIRST_GREATER;
-    if (key->k_objectid < objectid)
-        return SECOND_GREATER;
+    if (key->k_dir_id != skey->dir_id)
+        return (key->k_dir_id > skey->dir_id) ? FIRST_GREATER : SECOND_GREATER;
+    if (key->k_objectid != skey->objectid)
+        return (key->k_objectid > skey->objectid) ? FIRST_GREATER : SECOND_GREATER;
     
     // determine format of the on-disk key
-    key_type = (fsw_u32)FSW_U64_SHR(key->u.k_offset_v2.v, 60);
+    key_type = ((fsw_u8 *)&key->u.k_offset_v2.v)[7] >> 4;
     if (key_type != TYPE_DIRECT && key_type != TYPE_INDIRECT && key_type != TYPE_DIRENTRY) {
-        // detected 3.5 format (_v1)
-        key_offset = key->u.k_offset_v1.k_offset;
-    } else {
-        // detected 3.6 format (_v2)
-        key_offset = key->u.k_offset_v2.v & (~0ULL >> 4);
+        // detected 3.5 format (_v1), 32-bit offset
+        if (skey->offset_v1_overflow)
+            return SECOND_GREATER;
+        if (key->u.k_offset_v1.k_offset > skey->offset_v1)
+            return FIRST_GREATER;
+        if (key->u.k_offset_v1.k_offset < skey->offset_v1)
+            return SECOND_GREATER;
+        return KEYS_IDENTICAL;
     }
-    if (key_offset > offset)
+    
+    // detected 3.6 format (_v2)
+    key_offset = key->u.k_offset_v2.v & (~0ULL >> 4);
+    if (key_offset > skey->offset)
         return FIRST_GREATER;
-    if (key_offset < offset)
+    if (key_offset < skey->offset)
         return SECOND_GREATER;
     return KEYS_IDENTICAL;
 }
 
 /**
- * Find an item by key in the reiserfs tree.
+ * Binary search in a tree node for the search key. The keys are key_stride bytes apart,
+ * so this works for the key array of internal nodes as well as for the item head array
+ * of leaf nodes. Returns the number of keys that are less than or equal to the search key.
+ */
+
+static fsw_u32 fsw_reiserfs_key_bound(fsw_u8 *keys, fsw_u32 key_stride, fsw_u32 nr_keys,
+                                      struct fsw_reiserfs_search_key *skey)
+{
+    fsw_u32 lo, hi, mid;
+    
+    lo = 0;
+    hi = nr_keys;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (fsw_reiserfs_compare_key((struct reiserfs_key *)(keys + mid * key_stride), skey) == FIRST_GREATER)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/**
+ * Find an item by key in the reiserfs tree. The blocks along the path stay referenced
+ * until fsw_reiserfs_item_release is called; they are released on any error.
  */
 
 static fsw_status_t fsw_reiserfs_item_search(struct fsw_reiserfs_volume *vol,
@@ -637,84 +778,217 @@ static fsw_status_t fsw_reiserfs_item_search(struct fsw_reiserfs_volume *vol,
                                             struct fsw_reiserfs_item *item)
 {
     fsw_status_t    status;
-    int             comp_result;
-    fsw_u32         tree_bno, next_tree_bno, tree_level, nr_item, i;
+    fsw_u32         tree_bno, tree_level, nr_item, i;
     fsw_u8          *buffer;
-    struct block_head *bhead;
-    struct reiserfs_key *key;
-    struct item_head *ihead;
+    struct fsw_reiserfs_search_key skey;
     
     FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_search: searching %d/%d/%lld\n"), dir_id, objectid, offset));
     
-    // BIG TODOS: Use binary search within the item.
-    //  Remember tree path for "get next item" function.
+    // prepare the search key
+    skey.dir_id = dir_id;
+    skey.objectid = objectid;
+    skey.offset = offset;
+    skey.offset_v1 = (fsw_u32)offset;
+    skey.offset_v1_overflow = (offset > 0xffffffffUL) ? 1 : 0;
     
     item->valid = 0;
-    item->block_bno = 0;
+    for (tree_level = 0; tree_level < MAX_HEIGHT; tree_level++)
+        item->path_buffer[tree_level] = NULL;
     
     // walk the tree
     tree_bno = vol->sb->s_v1.s_root_block;
     for (tree_level = vol->sb->s_v1.s_tree_height - 1; ; tree_level--) {
         
         // get the current tree block into memory
-        status = fsw_block_get(vol, tree_bno, tree_level, (void **)&buffer);
+        status = fsw_reiserfs_item_path_get(vol, item, tree_level, tree_bno);
         if (status)
             return status;
-        bhead = (struct block_head *)buffer;
-        if (bhead->blk_level != tree_level) {
-            FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_item_search: tree block %d has not expected level %d\n"), tree_bno, tree_level));
-            fsw_block_release(vol, tree_bno, buffer);
-            return FSW_VOLUME_CORRUPTED;
-        }
-        nr_item = bhead->blk_nr_item;
+        buffer = item->path_buffer[tree_level];
+        nr_item = ((struct block_head *)buffer)->blk_nr_item;
         FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_reiserfs_item_search: visiting block %d level %d items %d\n"), tree_bno, tree_level, nr_item));
-        item->path_bno[tree_level] = tree_bno;
         
         // check if we have reached a leaf block
         if (tree_level == DISK_LEAF_NODE_LEVEL)
             break;
         
         // search internal node block, look for the path to follow
-        key = (struct reiserfs_key *)(buffer + BLKH_SIZE);
-        for (i = 0; i < nr_item; i++, key++) {
-            if (fsw_reiserfs_compare_key(key, dir_id, objectid, offset) == FIRST_GREATER)
-                break;
-        }
+        i = fsw_reiserfs_key_bound(buffer + BLKH_SIZE, KEY_SIZE, nr_item, &skey);
         item->path_index[tree_level] = i;
-        next_tree_bno = ((struct disk_child *)(buffer + BLKH_SIZE + nr_item * KEY_SIZE))[i].dc_block_number;
-        fsw_block_release(vol, tree_bno, buffer);
-        tree_bno = next_tree_bno;
+        tree_bno = ((struct disk_child *)(buffer + BLKH_SIZE + nr_item * KEY_SIZE))[i].dc_block_number;
     }
     
     // search leaf node block, look for our data
-    ihead = (struct item_head *)(buffer + BLKH_SIZE);
-    for (i = 0; i < nr_item; i++, ihead++) {
-        comp_result = fsw_reiserfs_compare_key(&ihead->ih_key, dir_id, objectid, offset);
-        if (comp_result == KEYS_IDENTICAL)
+    i = fsw_reiserfs_key_bound(buffer + BLKH_SIZE, IH_SIZE, nr_item, &skey);
+    if (i == 0) {
+        // All keys are greater than the search key.
+        fsw_reiserfs_item_release(vol, item);
+        return FSW_NOT_FOUND;
+    }
+    // Use the last key that is not greater than the search key. It is either identical
+    // or the preliminary result.
+    // NOTE: The first key of the next leaf block is guaranteed to be greater than
+    //  our search key.
+    item->path_index[tree_level] = i - 1;
+    
+    // Since we may have a key that is smaller than the search key, verify that
+    // it is for the same object.
+    return fsw_reiserfs_item_fill(vol, item, dir_id, objectid);
+}
+
+/**
+ * Get the next item for the same object from the reiserfs tree. The tree cursor moves
+ * up only as far as necessary, using the referenced blocks along its path, and then
+ * moves down the first pointers to the next leaf. If there is no next item for the
+ * object, the item is released and FSW_NOT_FOUND is returned.
+ */
+
+static fsw_status_t fsw_reiserfs_item_next(struct fsw_reiserfs_volume *vol,
+                                           struct fsw_reiserfs_item *item)
+{
+    fsw_status_t    status;
+    fsw_u32         tree_level, tree_height, nr_item, nr_ptr_item;
+    fsw_u8          *buffer;
+    
+    if (!item->valid)
+        return FSW_NOT_FOUND;
+    
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_next: next for %d/%d/%lld\n"),
+                   item->ih.ih_key.k_dir_id, item->ih.ih_key.k_objectid, item->item_offset));
+    
+    // find a node that has more items, moving up until we find one
+    tree_height = vol->sb->s_v1.s_tree_height;
+    for (tree_level = DISK_LEAF_NODE_LEVEL; tree_level < tree_height; tree_level++) {
+        nr_item = ((struct block_head *)item->path_buffer[tree_level])->blk_nr_item;
+        nr_ptr_item = nr_item + ((tree_level > DISK_LEAF_NODE_LEVEL) ? 1 : 0);  // internal nodes have (nr_item) keys and (nr_item+1) pointers
+        if (item->path_index[tree_level] + 1 < nr_ptr_item)
             break;
-        if (comp_result == FIRST_GREATER) {
-            // Current key is greater than the search key. Use the last key before this
-            // one as the preliminary result.
-            if (i == 0) {
-                fsw_block_release(vol, tree_bno, buffer);
-                return FSW_NOT_FOUND;
-            }
-            i--, ihead--;
+    }
+    if (tree_level >= tree_height) {
+        // we went to the highest level node and there still were no more items...
+        fsw_reiserfs_item_release(vol, item);
+        return FSW_NOT_FOUND;
+    }
+    item->path_index[tree_level]++;
+    
+    // we have a new path to follow, move down to the leaf node again
+    while (tree_level > DISK_LEAF_NODE_LEVEL) {
+        buffer = item->path_buffer[tree_level];
+        nr_item = ((struct block_head *)buffer)->blk_nr_item;
+        tree_level--;
+        status = fsw_reiserfs_item_path_get(vol, item, tree_level,
+                                            ((struct disk_child *)(buffer + BLKH_SIZE + nr_item * KEY_SIZE))[item->path_index[tree_level + 1]].dc_block_number);
+        if (status)
+            return status;
+        item->path_index[tree_level] = 0;
+    }
+    
+    // We now have the item that follows the previous one in the tree. Check that it
+    // belongs to the same object.
+    return fsw_reiserfs_item_fill(vol, item, item->ih.ih_key.k_dir_id, item->ih.ih_key.k_objectid);
+}
+
+/**
+ * Get the previous item for the same object from the reiserfs tree. This works like
+ * fsw_reiserfs_item_next, but moves down the last pointers to the previous leaf.
+ */
+
+static fsw_status_t fsw_reiserfs_item_prev(struct fsw_reiserfs_volume *vol,
+                                           struct fsw_reiserfs_item *item)
+{
+    fsw_status_t    status;
+    fsw_u32         tree_level, tree_height, nr_item;
+    fsw_u8          *buffer;
+    
+    if (!item->valid)
+        return FSW_NOT_FOUND;
+    
+    // find a node that has items before the current one, moving up until we find one
+    tree_height = vol->sb->s_v1.s_tree_height;
+    for (tree_level = DISK_LEAF_NODE_LEVEL; tree_level < tree_height; tree_level++) {
+        if (item->path_index[tree_level] > 0)
             break;
-        }
     }
-    if (i >= nr_item) {
-        // Go back to the last key, it was smaller than the search key.
-        // NOTE: The first key of the next leaf block is guaranteed to be greater than
-        //  our search key.
-        i--, ihead--;
+    if (tree_level >= tree_height) {
+        fsw_reiserfs_item_release(vol, item);
+        return FSW_NOT_FOUND;
+    }
+    item->path_index[tree_level]--;
+    
+    // move down to the leaf node again, always taking the last pointer
+    while (tree_level > DISK_LEAF_NODE_LEVEL) {
+        buffer = item->path_buffer[tree_level];
+        nr_item = ((struct block_head *)buffer)->blk_nr_item;
+        tree_level--;
+        status = fsw_reiserfs_item_path_get(vol, item, tree_level,
+                                            ((struct disk_child *)(buffer + BLKH_SIZE + nr_item * KEY_SIZE))[item->path_index[tree_level + 1]].dc_block_number);
+        if (status)
+            return status;
+        nr_item = ((struct block_head *)item->path_buffer[tree_level])->blk_nr_item;
+        if (tree_level == DISK_LEAF_NODE_LEVEL) {
+            if (nr_item == 0) {
+                fsw_reiserfs_item_release(vol, item);
+                return FSW_VOLUME_CORRUPTED;
+            }
+            item->path_index[tree_level] = nr_item - 1;
+        } else
+            item->path_index[tree_level] = nr_item;     // nr_item+1 pointers
     }
-    item->path_index[tree_level] = i;
-    // Since we may have a key that is smaller than the search key, verify that
-    // it is for the same object.
-    if (ihead->ih_key.k_dir_id != dir_id || ihead->ih_key.k_objectid != objectid) {
+    
+    return fsw_reiserfs_item_fill(vol, item, item->ih.ih_key.k_dir_id, item->ih.ih_key.k_objectid);
+}
+
+/**
+ * Replace the block referenced by a tree cursor at the given level. The new block is
+ * checked to be a tree node of that level. On error, all blocks of the cursor are released.
+ */
+
+static fsw_status_t fsw_reiserfs_item_path_get(struct fsw_reiserfs_volume *vol,
+                                               struct fsw_reiserfs_item *item,
+                                               fsw_u32 tree_level, fsw_u32 tree_bno)
+{
+    fsw_status_t    status;
+    fsw_u8          *buffer;
+    
+    if (item->path_buffer[tree_level] != NULL) {
+        fsw_block_release(vol, item->path_bno[tree_level], item->path_buffer[tree_level]);
+        item->path_buffer[tree_level] = NULL;
+    }
+    
+    status = fsw_block_get(vol, tree_bno, tree_level, (void **)&buffer);
+    if (status == FSW_SUCCESS && ((struct block_head *)buffer)->blk_level != tree_level) {
+        FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_item_path_get: tree block %d has not expected level %d\n"), tree_bno, tree_level));
         fsw_block_release(vol, tree_bno, buffer);
-        return FSW_NOT_FOUND;   // Found no key for this object at all
+        status = FSW_VOLUME_CORRUPTED;
+    }
+    if (status) {
+        fsw_reiserfs_item_release(vol, item);
+        return status;
+    }
+    
+    item->path_bno[tree_level] = tree_bno;
+    item->path_buffer[tree_level] = buffer;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Fill in the item information from the item head the tree cursor points at. If the
+ * item doesn't belong to the given object, the item is released and FSW_NOT_FOUND
+ * is returned.
+ */
+
+static fsw_status_t fsw_reiserfs_item_fill(struct fsw_reiserfs_volume *vol,
+                                           struct fsw_reiserfs_item *item,
+                                           fsw_u32 dir_id, fsw_u32 objectid)
+{
+    fsw_u8          *buffer;
+    struct item_head *ihead;
+    
+    buffer = item->path_buffer[DISK_LEAF_NODE_LEVEL];
+    ihead = ((struct item_head *)(buffer + BLKH_SIZE)) + item->path_index[DISK_LEAF_NODE_LEVEL];
+    
+    if (ihead->ih_key.k_dir_id != dir_id || ihead->ih_key.k_objectid != objectid) {
+        fsw_reiserfs_item_release(vol, item);
+        return FSW_NOT_FOUND;   // Found no key for this object
     }
     
     // return results
@@ -733,142 +1007,160 @@ static fsw_status_t fsw_reiserfs_item_search(struct fsw_reiserfs_volume *vol,
     item->item_data = buffer + ihead->ih_item_location;
     item->valid = 1;
     
-    // add information for block release
-    item->block_bno = tree_bno;
-    item->block_buffer = buffer;
-    
-    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_search: found %d/%d/%lld (%d)\n"),
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_fill: found %d/%d/%lld (%d)\n"),
                    ihead->ih_key.k_dir_id, ihead->ih_key.k_objectid, item->item_offset, item->item_type));
     return FSW_SUCCESS;
 }
 
 /**
- * Find the next item in the reiserfs tree for an already-found item.
+ * Release the disk blocks still referenced by an item search result. This also marks
+ * the item as invalid.
  */
 
-static fsw_status_t fsw_reiserfs_item_next(struct fsw_reiserfs_volume *vol,
-                                          struct fsw_reiserfs_item *item)
+static void fsw_reiserfs_item_release(struct fsw_reiserfs_volume *vol,
+                                      struct fsw_reiserfs_item *item)
 {
-    fsw_status_t    status;
-    fsw_u32         dir_id, objectid;
-    fsw_u64         offset;
-    fsw_u32         tree_bno, next_tree_bno, tree_level, nr_item, nr_ptr_item;
-    fsw_u8          *buffer;
-    struct block_head *bhead;
-    struct item_head *ihead;
+    fsw_u32         tree_level;
     
-    if (!item->valid)
-        return FSW_NOT_FOUND;
-    fsw_reiserfs_item_release(vol, item);   // TODO: maybe delay this and/or use the cached block!
-    
-    dir_id = item->ih.ih_key.k_dir_id;
-    objectid = item->ih.ih_key.k_objectid;
-    offset = item->item_offset;
+    for (tree_level = 0; tree_level < MAX_HEIGHT; tree_level++) {
+        if (item->path_buffer[tree_level] != NULL) {
+            fsw_block_release(vol, item->path_bno[tree_level], item->path_buffer[tree_level]);
+            item->path_buffer[tree_level] = NULL;
+        }
+    }
+    item->valid = 0;
+}
+
+/**
+ * Directory name hash "tea", based on the TEA block cipher. This follows the
+ * keyed_hash function of the Linux reiserfs driver, which works on signed chars.
+ */
+
+#define TEA_DELTA       0x9E3779B9UL
+#define TEA_FULLROUNDS  10
+#define TEA_PARTROUNDS  6
+
+#define TEA_CORE(rounds) \
+    do { \
+        fsw_u32 sum = 0; \
+        int n = rounds; \
+        fsw_u32 b0 = h0, b1 = h1; \
+        do { \
+            sum += TEA_DELTA; \
+            b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b); \
+            b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d); \
+        } while (--n); \
+        h0 += b0; \
+        h1 += b1; \
+    } while (0)
+
+static fsw_u32 fsw_reiserfs_hash_tea(fsw_u8 *name, fsw_u32 len)
+{
+    fsw_s8  *msg = (fsw_s8 *)name;
+    fsw_u32 h0 = 0x9464a485UL, h1 = 0x542e1a94UL;
+    fsw_u32 a, b, c, d, pad;
+    fsw_u32 i;
     
-    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_next: next for %d/%d/%lld\n"), dir_id, objectid, offset));
+    pad = len | (len << 8);
+    pad |= pad << 16;
     
-    // find a node that has more items, moving up until we find one
-    
-    for (tree_level = DISK_LEAF_NODE_LEVEL; tree_level < vol->sb->s_v1.s_tree_height; tree_level++) {
-        
-        // get the current tree block into memory
-        tree_bno = item->path_bno[tree_level];
-        status = fsw_block_get(vol, tree_bno, tree_level, (void **)&buffer);
-        if (status)
-            return status;
-        bhead = (struct block_head *)buffer;
-        if (bhead->blk_level != tree_level) {
-            FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_item_next: tree block %d has not expected level %d\n"), tree_bno, tree_level));
-            fsw_block_release(vol, tree_bno, buffer);
-            return FSW_VOLUME_CORRUPTED;
-        }
-        nr_item = bhead->blk_nr_item;
-        FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_reiserfs_item_next: visiting block %d level %d items %d\n"), tree_bno, tree_level, nr_item));
-        
-        nr_ptr_item = nr_item + ((tree_level > DISK_LEAF_NODE_LEVEL) ? 1 : 0);  // internal nodes have (nr_item) keys and (nr_item+1) pointers
-        item->path_index[tree_level]++;
-        if (item->path_index[tree_level] >= nr_ptr_item) {
-            item->path_index[tree_level] = 0;
-            fsw_block_release(vol, tree_bno, buffer);
-            continue;  // this node doesn't have any more items, move up one level
-        }
-        
-        // we have a new path to follow, move down to the leaf node again
-        while (tree_level > DISK_LEAF_NODE_LEVEL) {
-            // get next pointer from current block
-            next_tree_bno = ((struct disk_child *)(buffer + BLKH_SIZE + nr_item * KEY_SIZE))[item->path_index[tree_level]].dc_block_number;
-            fsw_block_release(vol, tree_bno, buffer);
-            tree_bno = next_tree_bno;
-            tree_level--;
-            
-            // get the current tree block into memory
-            status = fsw_block_get(vol, tree_bno, tree_level, (void **)&buffer);
-            if (status)
-                return status;
-            bhead = (struct block_head *)buffer;
-            if (bhead->blk_level != tree_level) {
-                FSW_MSG_ASSERT((FSW_MSGSTR("fsw_reiserfs_item_next: tree block %d has not expected level %d\n"), tree_bno, tree_level));
-                fsw_block_release(vol, tree_bno, buffer);
-                return FSW_VOLUME_CORRUPTED;
-            }
-            nr_item = bhead->blk_nr_item;
-            FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_reiserfs_item_next: visiting block %d level %d items %d\n"), tree_bno, tree_level, nr_item));
-            item->path_bno[tree_level] = tree_bno;
-        }
-        
-        // get the item from the leaf node
-        ihead = ((struct item_head *)(buffer + BLKH_SIZE)) + item->path_index[tree_level];
-        
-        // We now have the item that follows the previous one in the tree. Check that it
-        // belongs to the same object.
-        if (ihead->ih_key.k_dir_id != dir_id || ihead->ih_key.k_objectid != objectid) {
-            fsw_block_release(vol, tree_bno, buffer);
-            return FSW_NOT_FOUND;   // Found no next key for this object
-        }
-        
-        // return results
-        fsw_memcpy(&item->ih, ihead, sizeof(struct item_head));
-        item->item_type = (fsw_u32)FSW_U64_SHR(ihead->ih_key.u.k_offset_v2.v, 60);
-        if (item->item_type != TYPE_DIRECT &&
-            item->item_type != TYPE_INDIRECT &&
-            item->item_type != TYPE_DIRENTRY) {
-            // 3.5 format (_v1)
-            item->item_type = ihead->ih_key.u.k_offset_v1.k_uniqueness;
-            item->item_offset = ihead->ih_key.u.k_offset_v1.k_offset;
-        } else {
-            // 3.6 format (_v2)
-            item->item_offset = ihead->ih_key.u.k_offset_v2.v & (~0ULL >> 4);
-        }
-        item->item_data = buffer + ihead->ih_item_location;
-        item->valid = 1;
+    while (len >= 16) {
+        a = (fsw_u32)msg[0] | (fsw_u32)msg[1] << 8 | (fsw_u32)msg[2] << 16 | (fsw_u32)msg[3] << 24;
+        b = (fsw_u32)msg[4] | (fsw_u32)msg[5] << 8 | (fsw_u32)msg[6] << 16 | (fsw_u32)msg[7] << 24;
+        c = (fsw_u32)msg[8] | (fsw_u32)msg[9] << 8 | (fsw_u32)msg[10] << 16 | (fsw_u32)msg[11] << 24;
+        d = (fsw_u32)msg[12] | (fsw_u32)msg[13] << 8 | (fsw_u32)msg[14] << 16 | (fsw_u32)msg[15] << 24;
         
-        // add information for block release
-        item->block_bno = tree_bno;
-        item->block_buffer = buffer;
+        TEA_CORE(TEA_PARTROUNDS);
         
-        FSW_MSG_DEBUG((FSW_MSGSTR("fsw_reiserfs_item_next: found %d/%d/%lld (%d)\n"),
-                       ihead->ih_key.k_dir_id, ihead->ih_key.k_objectid, item->item_offset, item->item_type));
-        return FSW_SUCCESS;
+        len -= 16;
+        msg += 16;
     }
     
-    // we went to the highest level node and there still were no more items...
-    return FSW_NOT_FOUND;
+    if (len >= 12) {
+        a = (fsw_u32)msg[0] | (fsw_u32)msg[1] << 8 | (fsw_u32)msg[2] << 16 | (fsw_u32)msg[3] << 24;
+        b = (fsw_u32)msg[4] | (fsw_u32)msg[5] << 8 | (fsw_u32)msg[6] << 16 | (fsw_u32)msg[7] << 24;
+        c = (fsw_u32)msg[8] | (fsw_u32)msg[9] << 8 | (fsw_u32)msg[10] << 16 | (fsw_u32)msg[11] << 24;
+        d = pad;
+        for (i = 12; i < len; i++)
+            d = (d << 8) | (fsw_u32)msg[i];
+    } else if (len >= 8) {
+        a = (fsw_u32)msg[0] | (fsw_u32)msg[1] << 8 | (fsw_u32)msg[2] << 16 | (fsw_u32)msg[3] << 24;
+        b = (fsw_u32)msg[4] | (fsw_u32)msg[5] << 8 | (fsw_u32)msg[6] << 16 | (fsw_u32)msg[7] << 24;
+        c = d = pad;
+        for (i = 8; i < len; i++)
+            c = (c << 8) | (fsw_u32)msg[i];
+    } else if (len >= 4) {
+        a = (fsw_u32)msg[0] | (fsw_u32)msg[1] << 8 | (fsw_u32)msg[2] << 16 | (fsw_u32)msg[3] << 24;
+        b = c = d = pad;
+        for (i = 4; i < len; i++)
+            b = (b << 8) | (fsw_u32)msg[i];
+    } else {
+        a = b = c = d = pad;
+        for (i = 0; i < len; i++)
+            a = (a << 8) | (fsw_u32)msg[i];
+    }
+    
+    TEA_CORE(TEA_FULLROUNDS);
+    
+    return h0 ^ h1;
 }
 
 /**
- * Release the disk block still referenced by an item search result.
+ * Directory name hash "rupasov" (also known as "yura"). This follows the yura_hash
+ * function of the Linux reiserfs driver, which works on signed chars.
  */
 
-static void fsw_reiserfs_item_release(struct fsw_reiserfs_volume *vol,
-                                      struct fsw_reiserfs_item *item)
+static fsw_u32 fsw_reiserfs_hash_rupasov(fsw_u8 *name, fsw_u32 len)
 {
-    if (!item->valid)
-        return;
+    fsw_s8  *msg = (fsw_s8 *)name;
+    fsw_u32 i, j, pow, a, c;
+    
+    for (pow = 1, i = 1; i < len; i++)
+        pow = pow * 10;
+    
+    if (len == 1)
+        a = msg[0] - 48;
+    else
+        a = (msg[0] - 48) * pow;
+    
+    for (i = 1; i < len; i++) {
+        c = msg[i] - 48;
+        for (pow = 1, j = i; j < len - 1; j++)
+            pow = pow * 10;
+        a = a + c * pow;
+    }
+    
+    // the original pads the name with '0' characters (which add nothing) up to 40,
+    //  then with the character codes up to 255
+    if (i < 40)
+        i = 40;
+    for (; i < 256; i++) {
+        c = i;
+        for (pow = 1, j = i; j < len - 1; j++)
+            pow = pow * 10;
+        a = a + c * pow;
+    }
+    
+    return a << 7;
+}
+
+/**
+ * Directory name hash "r5", the default for new file systems. This follows the
+ * r5_hash function of the Linux reiserfs driver, which works on signed chars and
+ * stops at a null character.
+ */
+
+static fsw_u32 fsw_reiserfs_hash_r5(fsw_u8 *name, fsw_u32 len)
+{
+    fsw_s8  *msg = (fsw_s8 *)name;
+    fsw_u32 a = 0, i;
     
-    if (item->block_bno > 0) {
-        fsw_block_release(vol, item->block_bno, item->block_buffer);
-        item->block_bno = 0;
+    for (i = 0; i < len && msg[i] != 0; i++) {
+        a += (fsw_u32)msg[i] << 4;
+        a += (fsw_u32)(msg[i] >> 4);
+        a *= 11;
     }
+    return a;
 }
 
 // EOF
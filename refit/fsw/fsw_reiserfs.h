@@ -38,7 +38,10 @@
 
 
 /**
- * ReiserFS: Results from a tree search.
+ * ReiserFS: Results from a tree search. This also works as a cursor into the tree: All
+ * blocks along the path from the root to the item's leaf stay referenced until the item
+ * is released, so that moving to the next or previous item doesn't need to search the
+ * tree from the root again.
  */
 
 struct fsw_reiserfs_item {
@@ -51,13 +54,10 @@ struct fsw_reiserfs_item {
     
     fsw_u8 *item_data;
     
-    // path information
+    // path information, indexed by tree level
     fsw_u32 path_bno[MAX_HEIGHT];
     fsw_u32 path_index[MAX_HEIGHT];
-    
-    // block release information
-    fsw_u32 block_bno;
-    void *block_buffer;
+    fsw_u8 *path_buffer[MAX_HEIGHT];    // referenced blocks, or NULL
 };
 
 
@@ -70,6 +70,7 @@ struct fsw_reiserfs_volume {
     
     struct reiserfs_super_block *sb;  //!< Full raw reiserfs superblock structure
     int version;                    //!< Flag for 3.5 or 3.6 format
+    fsw_u32 (*hash_function)(fsw_u8 *name, fsw_u32 len);  //!< Directory entry name hash, or NULL if unknown
 };
 
 /**
@@ -84,5 +85,17 @@ struct fsw_reiserfs_dnode {
     struct stat_data *sd_v2;        //!< Full stat_data, version 2
 };
 
+/**
+ * ReiserFS: Key for a tree search, prepared once for all key comparisons of the search.
+ */
+
+struct fsw_reiserfs_search_key {
+    fsw_u32 dir_id;                 //!< Locality ID of the object
+    fsw_u32 objectid;               //!< Object ID
+    fsw_u64 offset;                 //!< Offset within the object, compared against 3.6 format keys
+    fsw_u32 offset_v1;              //!< Offset truncated to 32 bits, compared against 3.5 format keys
+    int offset_v1_overflow;         //!< Flag: Offset is larger than any 3.5 format key offset
+};
+
 
 #endif
@@ -81,17 +81,10 @@ void errore(const char *msg, ...)
 UINTN read_sector(UINT64 lba, UINT8 *buffer)
 {
     off_t   offset;
-    off_t   result_seek;
     ssize_t result_read;
     
     offset = lba * 512;
-    result_seek = lseek(fd, offset, SEEK_SET);
-    if (result_seek != offset) {
-        errore("Seek to %llu failed", offset);
-        return 1;
-    }
-    
-    result_read = read(fd, buffer, 512);
+    result_read = pread(fd, buffer, 512, offset);
     if (result_read < 0) {
         errore("Data read failed at position %llu", offset);
         return 1;
@@ -106,17 +99,10 @@ UINTN read_sector(UINT64 lba, UINT8 *buffer)
 UINTN write_sector(UINT64 lba, UINT8 *buffer)
 {
     off_t   offset;
-    off_t   result_seek;
     ssize_t result_write;
     
     offset = lba * 512;
-    result_seek = lseek(fd, offset, SEEK_SET);
-    if (result_seek != offset) {
-        errore("Seek to %llu failed", offset);
-        return 1;
-    }
-    
-    result_write = write(fd, buffer, 512);
+    result_write = pwrite(fd, buffer, 512, offset);
     if (result_write < 0) {
         errore("Data write failed at position %llu", offset);
         return 1;